@@ -75,7 +75,7 @@ typedef struct {
           RO RSVD( 5, 0x030C, 0x03FC ); // 0x030C...0x03FC : reserved
           RW uint32_t IPRIORITYR[ 24 ]; // 0x0400...0x045C : priority
           RO RSVD( 6, 0x0460, 0x07FC ); // 0x0460...0x07FC : reserved
-          RO uint32_t  ITARGETSR[ 24 ]; // 0x0800...0x085C : processor target
+          RW uint32_t  ITARGETSR[ 24 ]; // 0x0800...0x085C : processor target
           RO RSVD( 7, 0x0860, 0x0BFC ); // 0x0760...0x0BFC : reserved
           RW uint32_t      ICFGR0;      // 0x0C00          : configuration
           RW uint32_t      ICFGR1;      // 0x0C04          : configuration
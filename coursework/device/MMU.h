@@ -30,4 +30,37 @@ void mmu_set_ptr1( uint32_t* x );
 // configure MMU: set 2-bit permission field of domain d to x
 void mmu_set_dom( int d, uint8_t x );
 
+// configure MMU: set current ASID (i.e., CONTEXTIDR) to x
+void mmu_set_asid( uint32_t x );
+// flush   TLB entry for address x (bits 31...12) and ASID x (bits 7...0)
+void mmu_flush_va( uint32_t x );
+
+// read fault status  (i.e., DFSR) for most recent data abort
+uint32_t mmu_get_dfsr();
+// read fault address (i.e., DFAR) for most recent data abort
+uint32_t mmu_get_dfar();
+// read fault status  (i.e., IFSR) for most recent prefetch abort
+uint32_t mmu_get_ifsr();
+// read fault address (i.e., IFAR) for most recent prefetch abort
+uint32_t mmu_get_ifar();
+
+// set user read-only thread ID register (i.e., TPIDRURO) to x
+void mmu_set_tls( uint32_t x );
+
+//  enable caches, i.e., D-cache, I-cache and branch prediction
+void cache_enable();
+// disable caches, i.e., D-cache, I-cache and branch prediction
+void cache_unable();
+
+// clean and invalidate entire D-cache (by set/way)
+void cache_flush_all();
+// clean      D-cache lines covering n bytes from x
+void cache_clean( void* x, size_t n );
+// invalidate D-cache lines covering n bytes from x
+void cache_invalidate( void* x, size_t n );
+// clean and invalidate D-cache lines covering n bytes from x
+void cache_flush( void* x, size_t n );
+// invalidate entire I-cache and branch predictor
+void cache_invalidate_icache();
+
 #endif
@@ -32,6 +32,23 @@
 	
 .global mmu_set_dom
 
+.global mmu_set_asid
+.global mmu_flush_va
+.global mmu_get_dfsr
+.global mmu_get_dfar
+.global mmu_get_ifsr
+.global mmu_get_ifar
+.global mmu_set_tls
+
+.global cache_enable
+.global cache_unable
+
+.global cache_flush_all
+.global cache_clean
+.global cache_invalidate
+.global cache_flush
+.global cache_invalidate_icache
+
 mmu_enable:          mrc   p15, 0, r0, c1, c0, 0 @ read  SCTLR
                      orr   r0, r0, #0x1          @ set   SCTLR[ M ] = 1 => MMU  enable
                      mcr   p15, 0, r0, c1, c0, 0 @ write SCTLR
@@ -46,6 +63,14 @@ mmu_unable:          mrc   p15, 0, r0, c1, c0, 0 @ read  SCTLR
 
 mmu_flush:           mov   r0,     #0x0
                      mcr   p15, 0, r0, c8, c7, 0 @ write TLBIALL
+                     dsb
+                     isb
+
+                     mov   pc, lr                @ return
+
+mmu_flush_va:        mcr   p15, 0, r0, c8, c7, 1 @ write TLBIMVA
+                     dsb
+                     isb
 
                      mov   pc, lr                @ return
 
@@ -69,3 +94,151 @@ mmu_set_dom:         add   r0, r0, r0            @ compute i (index      from do
 
                      mov   pc, lr                @ return
 
+mmu_set_asid:        isb                         @ complete any preceding TTBR0 update
+                     mcr   p15, 0, r0, c13, c0, 1 @ write CONTEXTIDR
+                     isb
+
+                     mov   pc, lr                @ return
+
+mmu_get_dfsr:        mrc   p15, 0, r0, c5, c0, 0 @ read  DFSR
+
+                     mov   pc, lr                @ return
+
+mmu_get_dfar:        mrc   p15, 0, r0, c6, c0, 0 @ read  DFAR
+
+                     mov   pc, lr                @ return
+
+mmu_get_ifsr:        mrc   p15, 0, r0, c5, c0, 1 @ read  IFSR
+
+                     mov   pc, lr                @ return
+
+mmu_get_ifar:        mrc   p15, 0, r0, c6, c0, 2 @ read  IFAR
+
+                     mov   pc, lr                @ return
+
+mmu_set_tls:         mcr   p15, 0, r0, c13, c0, 3 @ write TPIDRURO
+
+                     mov   pc, lr                @ return
+
+/* Section B2.2 of the same document covers caches and branch predictors:
+ * per Section B4.1.130, SCTLR[ C ], SCTLR[ I ] and SCTLR[ Z ] enable the
+ * D-cache, I-cache and branch prediction respectively, and per Section
+ * B4.2.1 maintenance operations are again writes to co-processor 15, e.g.,
+ *
+ * id = p15, opc1 = 0, CRn = c7, CRm = c10, opc2 = 1
+ *
+ * cleans a D-cache line by (virtual) address.  The range-based functions
+ * derive the line length from CTR, whereas cache_flush_all iterates over
+ * each level, set and way described by CLIDR and CCSIDR.
+ */
+
+cache_enable:        mrc   p15, 0, r0, c1, c0, 0 @ read  SCTLR
+                     orr   r0, r0, #0x4          @ set   SCTLR[ C ] = 1 => D-cache enable
+                     orr   r0, r0, #0x1800       @ set   SCTLR[ I ] = 1 => I-cache enable, SCTLR[ Z ] = 1 => branch prediction enable
+                     mcr   p15, 0, r0, c1, c0, 0 @ write SCTLR
+                     isb
+
+                     mov   pc, lr                @ return
+
+cache_unable:        mrc   p15, 0, r0, c1, c0, 0 @ read  SCTLR
+                     bic   r0, r0, #0x4          @ set   SCTLR[ C ] = 0 => D-cache disable
+                     bic   r0, r0, #0x1800       @ set   SCTLR[ I ] = 0 => I-cache disable, SCTLR[ Z ] = 0 => branch prediction disable
+                     mcr   p15, 0, r0, c1, c0, 0 @ write SCTLR
+                     isb
+
+                     mov   pc, lr                @ return
+
+cache_flush_all:     push  { r4-r11 }
+                     mrc   p15, 1, r0, c0, c0, 1 @ read  CLIDR
+                     ands  r3, r0, #0x07000000   @ extract level of coherence ...
+                     mov   r3, r3, lsr #23       @ ... times 2
+                     beq   cache_l4              @ done if level of coherence = 0
+                     mov   r10, #0               @ r10 = cache level times 2
+
+cache_l0:            add   r2, r10, r10, lsr #1  @ r2 = cache level times 3
+                     mov   r1, r0, lsr r2        @ extract cache type for this level
+                     and   r1, r1, #7
+                     cmp   r1, #2
+                     blt   cache_l3              @ skip if no D-cache at this level
+                     mcr   p15, 2, r10, c0, c0, 0 @ write CSSELR, selecting this level
+                     isb
+                     mrc   p15, 1, r1, c0, c0, 0 @ read  CCSIDR
+                     and   r2, r1, #7            @ extract log2( line length ) - 4 ...
+                     add   r2, r2, #4            @ ... and add 4 for the set shift
+                     ldr   r4, =0x3FF
+                     ands  r4, r4, r1, lsr #3    @ r4 = maximum way number
+                     clz   r5, r4                @ r5 = way shift
+                     ldr   r7, =0x7FFF
+                     ands  r7, r7, r1, lsr #13   @ r7 = maximum set number
+
+cache_l1:            mov   r9, r4                @ r9 = working copy of way number
+
+cache_l2:            orr   r11, r10, r9, lsl r5  @ combine level and way ...
+                     orr   r11, r11, r7, lsl r2  @ ... and set
+                     mcr   p15, 0, r11, c7, c14, 2 @ write DCCISW, i.e., clean and invalidate by set/way
+                     subs  r9, r9, #1
+                     bge   cache_l2
+                     subs  r7, r7, #1
+                     bge   cache_l1
+
+cache_l3:            add   r10, r10, #2          @ next level
+                     cmp   r3, r10
+                     bgt   cache_l0
+
+cache_l4:            mov   r10, #0
+                     mcr   p15, 2, r10, c0, c0, 0 @ write CSSELR, selecting level 1
+                     dsb
+                     isb
+                     pop   { r4-r11 }
+
+                     mov   pc, lr                @ return
+
+cache_line:          mrc   p15, 0, r3, c0, c0, 1 @ read  CTR
+                     mov   r3, r3, lsr #16       @ extract log2( words per D-cache line )
+                     and   r3, r3, #0xF
+                     mov   r2, #4
+                     mov   r2, r2, lsl r3        @ r2 = D-cache line length
+                     sub   r3, r2, #1
+                     add   r1, r0, r1            @ r1 = limit
+                     bic   r0, r0, r3            @ align start to line
+
+                     mov   pc, lr                @ return
+
+cache_clean:         mov   r12, lr
+                     bl    cache_line
+cache_clean_l0:      mcr   p15, 0, r0, c7, c10, 1 @ write DCCMVAC, i.e., clean by address
+                     add   r0, r0, r2
+                     cmp   r0, r1
+                     blo   cache_clean_l0
+                     dsb
+
+                     mov   pc, r12               @ return
+
+cache_invalidate:    mov   r12, lr
+                     bl    cache_line
+cache_invalidate_l0: mcr   p15, 0, r0, c7, c6, 1 @ write DCIMVAC, i.e., invalidate by address
+                     add   r0, r0, r2
+                     cmp   r0, r1
+                     blo   cache_invalidate_l0
+                     dsb
+
+                     mov   pc, r12               @ return
+
+cache_flush:         mov   r12, lr
+                     bl    cache_line
+cache_flush_l0:      mcr   p15, 0, r0, c7, c14, 1 @ write DCCIMVAC, i.e., clean and invalidate by address
+                     add   r0, r0, r2
+                     cmp   r0, r1
+                     blo   cache_flush_l0
+                     dsb
+
+                     mov   pc, r12               @ return
+
+cache_invalidate_icache:
+                     mov   r0, #0
+                     mcr   p15, 0, r0, c7, c5, 0 @ write ICIALLU, i.e., invalidate I-cache
+                     mcr   p15, 0, r0, c7, c5, 6 @ write BPIALL,  i.e., invalidate branch predictor
+                     dsb
+                     isb
+
+                     mov   pc, lr                @ return
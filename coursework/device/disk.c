@@ -119,3 +119,82 @@ int disk_rd( uint32_t a,       uint8_t* x, int n ) {
 
   return DISK_FAILURE;
 }
+
+int disk_ack( uint8_t* x, int n ) {
+  if( PL011_geth( UART2, true ) == 0x00 ) { // read  command
+    if( x != NULL ) {
+      PL011_getc( UART2,       true );      // read  separator
+       data_geth( UART2, x, n, true );      // read  data
+    }
+      PL011_getc( UART2,       true );      // read  EOL
+
+    return DISK_SUCCESS;
+  }
+  else {
+      PL011_getc( UART2,       true );      // read  EOL
+
+    return DISK_FAILURE;
+  }
+}
+
+int disk_wr_n( uint32_t a, const uint8_t* x, int n, int k ) {
+  int r = DISK_SUCCESS;
+
+  for( int i = 0, j = 0; j < k; ) {
+    if( ( i < k ) && ( ( i - j ) < DISK_WINDOW ) ) {
+      PL011_puth( UART2, 0x01, true );        // write command
+      PL011_putc( UART2, ' ',  true );        // write separator
+       addr_puth( UART2, a + i, true );       // write address
+      PL011_putc( UART2, ' ',  true );        // write separator
+       data_puth( UART2, x + ( i * n ), n, true ); // write data
+      PL011_putc( UART2, '\n', true );        // write EOL
+
+      i++;
+    }
+    else {
+      if( disk_ack( NULL, 0 ) != DISK_SUCCESS ) {
+        r = DISK_FAILURE;
+      }
+
+      j++;
+    }
+  }
+
+  for( int i = 0; ( r != DISK_SUCCESS ) && ( i < k ); i++ ) {
+    if( disk_wr( a + i, x + ( i * n ), n ) != DISK_SUCCESS ) {
+      return DISK_FAILURE;
+    }
+  }
+
+  return DISK_SUCCESS;
+}
+
+int disk_rd_n( uint32_t a,       uint8_t* x, int n, int k ) {
+  int r = DISK_SUCCESS;
+
+  for( int i = 0, j = 0; j < k; ) {
+    if( ( i < k ) && ( ( i - j ) < DISK_WINDOW ) ) {
+      PL011_puth( UART2, 0x02, true );        // write command
+      PL011_putc( UART2, ' ',  true );        // write separator
+       addr_puth( UART2, a + i, true );       // write address
+      PL011_putc( UART2, '\n', true );        // write EOL
+
+      i++;
+    }
+    else {
+      if( disk_ack( x + ( j * n ), n ) != DISK_SUCCESS ) {
+        r = DISK_FAILURE;
+      }
+
+      j++;
+    }
+  }
+
+  for( int i = 0; ( r != DISK_SUCCESS ) && ( i < k ); i++ ) {
+    if( disk_rd( a + i, x + ( i * n ), n ) != DISK_SUCCESS ) {
+      return DISK_FAILURE;
+    }
+  }
+
+  return DISK_SUCCESS;
+}
@@ -26,6 +26,7 @@
  */
 
 #define DISK_RETRY   (  3 )
+#define DISK_WINDOW  ( 16 )
 
 #define DISK_SUCCESS (  0 )
 #define DISK_FAILURE ( -1 )
@@ -40,4 +41,16 @@ extern int disk_wr( uint32_t a, const uint8_t* x, int n );
 // read  an n-byte block of data x from the disk at block address a
 extern int disk_rd( uint32_t a,       uint8_t* x, int n );
 
+/* The following functions transfer k consecutive blocks, starting at
+ * block address a: rather than wait for each response before sending the
+ * next request, up to DISK_WINDOW requests are outstanding at once, which
+ * hides most of the round-trip latency.  Should any request fail, every
+ * block is transferred again one at a time (and so retried as above).
+ */
+
+// write k n-byte blocks of data x to   the disk at block address a onward
+extern int disk_wr_n( uint32_t a, const uint8_t* x, int n, int k );
+// read  k n-byte blocks of data x from the disk at block address a onward
+extern int disk_rd_n( uint32_t a,       uint8_t* x, int n, int k );
+
 #endif
@@ -0,0 +1,172 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+fiq_ring_t fiq_ring;
+work_t fiq_work;
+
+void fiq_bh(void *arg)
+{
+  wakeup(&fiq_ring);
+}
+
+void fiq_sgi(uint32_t id)
+{
+  softirq_raise(&fiq_work);
+}
+
+void fiq_init()
+{
+  memset(&fiq_ring, 0, sizeof(fiq_ring_t));
+  fiq_ring.clock = &SYSCONF->COUNTER_24MHZ;
+  fiq_ring.sgir = &GICD0->SGIR;
+  fiq_ring.sgi = 0x02000000 | FIQ_SGI; // target filter = self
+
+  work_init(&fiq_work, fiq_bh, NULL);
+  lolevel_init_fiq(FIQ_UART, &fiq_ring, GICC1); // harmless, even if no FIQ is ever taken
+
+  if (!FIQ_ROUTE)
+  {
+    irq_register(FIQ_SOURCE, fiq_irq, IRQ_PRIORITY_UART, IRQ_AFFINITY_CPU0);
+    FIQ_UART->IMSC |= 0x00000050; // enable UART (Rx and Rx timeout) interrupt
+    return;
+  }
+
+  irq_register(FIQ_SGI, fiq_sgi, IRQ_PRIORITY_UART, IRQ_AFFINITY_CPU0);
+
+  GICD1->CTLR = 0x00000000; // disable GIC distributor
+  ((volatile uint8_t *)(GICD1->IPRIORITYR))[FIQ_SOURCE] = IRQ_PRIORITY_HIGHEST;
+  ((volatile uint8_t *)(GICD1->ITARGETSR))[FIQ_SOURCE] = IRQ_AFFINITY_CPU0;
+  (&GICD1->ISENABLER0)[FIQ_SOURCE / 32] = 1 << (FIQ_SOURCE % 32);
+  GICC1->PMR = IRQ_PRIORITY_MASK; // unmask all            interrupts
+  GICC1->CTLR = 0x00000001;       // enable GIC interface
+  GICD1->CTLR = 0x00000001;       // enable GIC distributor
+
+  FIQ_UART->IMSC |= 0x00000050; // enable UART (Rx and Rx timeout) interrupt
+}
+
+void fiq_irq(uint32_t id)
+{
+  fiq_ring.stamp = *fiq_ring.clock;
+  fiq_ring.count++;
+
+  while (!(FIQ_UART->FR & 0x10)) // i.e., until receive FIFO empty
+  {
+    uint8_t x = FIQ_UART->DR;
+
+    if ((fiq_ring.head - fiq_ring.tail) >= FIQ_RING_SIZE)
+    {
+      fiq_ring.dropped++;
+      continue;
+    }
+
+    fiq_ring.data[fiq_ring.head % FIQ_RING_SIZE] = x;
+    fiq_ring.head++;
+  }
+
+  softirq_raise(&fiq_work);
+}
+
+int fiq_read(uint8_t *x, int n)
+{
+  uint32_t tail = fiq_ring.tail;
+  int r = 0;
+
+  while ((r < n) && (tail != fiq_ring.head))
+  {
+    x[r++] = fiq_ring.data[tail % FIQ_RING_SIZE];
+    tail++;
+  }
+
+  fiq_ring.tail = tail;
+
+  return r;
+}
+
+typedef struct
+{
+  uint32_t min, max, sum, n;
+} latency_t;
+
+volatile bool probe_seen;
+volatile uint32_t probe_stamp;
+
+void probe_irq(uint32_t id)
+{
+  probe_stamp = SYSCONF->COUNTER_24MHZ;
+  probe_seen = true;
+}
+
+void latency_sample(latency_t *l, uint32_t x)
+{
+  l->min = (x < l->min) ? x : l->min;
+  l->max = (x > l->max) ? x : l->max;
+  l->sum += x;
+  l->n++;
+}
+
+void latency_print(char *x, latency_t *l)
+{
+  uint32_t r[3] = {l->min, (l->n > 0) ? (l->sum / l->n) : 0, l->max};
+
+  print(x, strlen(x));
+  for (int i = 0; i < 3; i++)
+  {
+    PL011_putc(UART0, ' ', true);
+    for (int j = 24; j >= 0; j -= 8)
+    {
+      PL011_puth(UART0, (r[i] >> j) & 0xFF, true);
+    }
+  }
+  PL011_putc(UART0, '\n', true);
+}
+
+void fiq_measure(int n)
+{
+  latency_t fiq = {UINT32_MAX, 0, 0, 0};
+  latency_t irq = {UINT32_MAX, 0, 0, 0};
+
+  irq_register(FIQ_PROBE_IRQ, probe_irq, IRQ_PRIORITY_UART, IRQ_AFFINITY_CPU0);
+
+  int_enable_fiq();
+  int_enable_irq();
+
+  for (int i = 0; FIQ_ROUTE && (i < n); i++)
+  {
+    uint32_t count = fiq_ring.count;
+    uint32_t t0 = SYSCONF->COUNTER_24MHZ;
+    (&GICD1->ISPENDR0)[FIQ_SOURCE / 32] = 1 << (FIQ_SOURCE % 32);
+    for (int j = 0; (j < FIQ_PROBE_WAIT) && (fiq_ring.count == count); j++)
+      ;
+    if (fiq_ring.count != count)
+    {
+      latency_sample(&fiq, fiq_ring.stamp - t0);
+    }
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    probe_seen = false;
+    uint32_t t0 = SYSCONF->COUNTER_24MHZ;
+    (&GICD0->ISPENDR0)[FIQ_PROBE_IRQ / 32] = 1 << (FIQ_PROBE_IRQ % 32);
+    for (int j = 0; (j < FIQ_PROBE_WAIT) && !probe_seen; j++)
+      ;
+    if (probe_seen)
+    {
+      latency_sample(&irq, probe_stamp - t0);
+    }
+  }
+
+  int_unable_irq();
+
+  irq_unregister(FIQ_PROBE_IRQ);
+
+  // report min, average and max, in 24MHz counter ticks
+  latency_print("FIQ latency:", &fiq);
+  latency_print("IRQ latency:", &irq);
+}
@@ -0,0 +1,94 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __FIQ_H
+#define __FIQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "GIC.h"
+#include "PL011.h"
+#include "SYS.h"
+
+/* One latency-critical source can be routed as an FIQ (via GIC1) rather
+ * than an IRQ, iff. FIQ_ROUTE is non-zero.  That relies on the platform
+ * raising nFIQ from GIC1, which has yet to be seen to happen under QEMU's
+ * realview-pb-a8 model (so do not set FIQ_ROUTE until FIQ_MEASURE shows
+ * FIQs being taken under make launch-qemu).  By default, the source is
+ * instead handled by fiq_irq via GIC0 like any other IRQ, which fills the
+ * same ring, so the rest of the kernel cannot tell the difference.
+ *
+ * The low-level FIQ handler relies on the banked FIQ mode registers, so
+ * saves nothing:
+ *
+ * - r8  = base address of the PL011 being serviced,
+ * - r9  = address of fiq_ring,
+ * - r12 = base address of the GIC1 CPU interface, and
+ * - r10, r11 are scratch.
+ *
+ * It drains the receive FIFO into fiq_ring, then raises FIQ_SGI on GIC0
+ * so everything else (e.g., waking a reader) happens via the normal IRQ
+ * and bottom-half path.  The handler hard-codes the fiq_ring_t offsets
+ * below and FIQ_RING_SIZE, so any change must be mirrored in lolevel.s.
+ */
+
+#define FIQ_UART         UART0
+#define FIQ_SOURCE       GIC_SOURCE_UART0
+#define FIQ_SGI          ( 1 )
+#define FIQ_RING_SIZE    ( 256 )
+
+#ifndef FIQ_ROUTE
+#define FIQ_ROUTE        ( 0 )
+#endif
+
+/* If FIQ_MEASURE is non-zero, then that many samples of interrupt-entry
+ * latency are taken at boot for both paths: the FIQ source (resp. the
+ * otherwise unused FIQ_PROBE_IRQ source) is made pending via GIC1 (resp.
+ * GIC0), and the 24MHz counter is compared with its value on entry to the
+ * FIQ handler (resp. registered IRQ handler).  The FIQ path is sampled iff.
+ * FIQ_ROUTE is non-zero; if FIQs are not delivered, every sample times out
+ * and the FIQ line reports n = 0.  Both can be set at build time, e.g., by
+ * adding -DFIQ_ROUTE=1 -DFIQ_MEASURE=64 to the compiler flags.
+ */
+
+#ifndef FIQ_MEASURE
+#define FIQ_MEASURE      ( 0 )
+#endif
+#define FIQ_PROBE_IRQ    GIC_SOURCE_TIMER1
+#define FIQ_PROBE_WAIT   ( 0x100000 )
+
+typedef struct
+{
+  volatile uint32_t head;      // 0x0000 : write index, updated by FIQ handler
+  volatile uint32_t tail;      // 0x0004 : read  index, updated by consumer
+  volatile uint32_t dropped;   // 0x0008 : bytes dropped because ring was full
+  volatile uint32_t count;     // 0x000C : FIQs taken
+  volatile uint32_t stamp;     // 0x0010 : clock at most recent handler entry
+  volatile uint32_t iar;       // 0x0014 : GIC1 IAR read on entry, written to EOIR
+  volatile uint32_t *clock;    // 0x0018 : clock read on entry
+  volatile uint32_t *sgir;     // 0x001C : GICD0 SGIR
+  uint32_t sgi;                // 0x0020 : SGIR value raising FIQ_SGI on self
+  uint8_t data[FIQ_RING_SIZE]; // 0x0024 : buffered data
+} fiq_ring_t;
+
+extern fiq_ring_t fiq_ring;
+
+// route FIQ_SOURCE as an FIQ (or, by default, an IRQ), and register the bottom half on GIC0
+extern void fiq_init();
+// drain FIQ_UART into fiq_ring, i.e., the IRQ-based equivalent of the FIQ handler
+extern void fiq_irq(uint32_t id);
+// read up to n buffered bytes into x; return bytes read
+extern int fiq_read(uint8_t *x, int n);
+// sample interrupt-entry latency of FIQ vs. IRQ path n times, and report it
+extern void fiq_measure(int n);
+
+// low-level: load the banked FIQ mode registers
+extern void lolevel_init_fiq(PL011_t *uart, fiq_ring_t *ring, GICC_t *gicc);
+
+#endif
@@ -7,21 +7,23 @@
 
 #include "hilevel.h"
 
-/* We assume there will be two user processes, stemming from execution of the 
- * two user programs P1 and P2, and can therefore
+/* Processes are created by fork (starting from the console), so we
  * 
- * - allocate a fixed-size process table (of PCBs), and then maintain an index 
- *   into it to keep track of the currently executing process, and
- * - employ a fixed-case of round-robin scheduling: no more processes can be 
- *   created, and neither can be terminated, so assume both are always ready
- *   to execute.
+ * - allocate PCBs on demand from a growable process table (see proc.c), 
+ *   and then maintain a pointer to the currently executing process, and
+ * - employ priority-based scheduling with aging, falling back to an idle
+ *   kernel thread whenever no process is ready to execute.
  */
 
-pcb_t procTab[MAX_PROCS];
+
 pcb_t *executing = NULL;
-uint32_t stack_offset = 0x1000;
-uint32_t activeprocs = 1;
-fd_t fdtable[MAX_FDS];
+pcb_t *idle = NULL;
+pcb_t *init = NULL;
+slab_cache_t pipe_cache = SLAB_CACHE("pipe", pipe_t, NULL);
+bool need_resched = false;
+int preempt_count = 0;
+uint32_t ticks = 0;
+work_t tick_work;
 
 void print(char *x, int n)
 {
@@ -53,6 +55,18 @@ void dispatch(ctx_t *ctx, pcb_t *prev, pcb_t *next)
   PL011_putc(UART0, next_pid, true);
   PL011_putc(UART0, ']', true);
 
+  if (NULL != next)
+  {
+    vm_switch(next->as); // kernel threads have none, i.e., use the kernel's
+    mmu_set_tls(next->tls);
+
+    kdata_begin();
+    kdata->pid = next->pid;
+    kdata->switches++;
+    kdata->procs = proc_count;
+    kdata_end();
+  }
+
   executing = next; // update   executing process to P_{next}
 
   return;
@@ -62,344 +76,1132 @@ void schedule(ctx_t *ctx)
 {
 
   int priorityy = 0;
-  int current = 0;
-  int next = 0;
+  pcb_t *current = executing;
+  pcb_t *next = NULL;
 
-  int prboundary = -1;
-  for (int i = 0; i < activeprocs; i++)
+  int prboundary = INT32_MIN;
+  uint32_t runnable = 0;
+  for (pcb_t *p = proc_list; p != NULL; p = p->next)
   {
-    priorityy = procTab[i].priority + procTab[i].age + procTab[i].niceness;
+    priorityy = p->priority + p->age + p->niceness;
+
+    if ((p != idle) && ((p->status == STATUS_READY) || (p->status == STATUS_EXECUTING)))
+    {
+      runnable++;
+    }
 
-    if ((priorityy > prboundary) && ((procTab[i].status == STATUS_READY) || (procTab[i].status == STATUS_EXECUTING)))
+    if ((p != idle) && (priorityy > prboundary) && ((p->status == STATUS_READY) || (p->status == STATUS_EXECUTING)))
     {
 
-      next = i;
+      next = p;
       prboundary = priorityy;
     }
   }
+
+  // nothing else is ready, so fall back to the idle thread
+  if (next == NULL)
+  {
+    next = idle;
+  }
+
   // resetting the age of the next executing process
-  procTab[next].age = 0;
+  next->age = 0;
 
   // aging the other processes that are not executing
-  for (int i = 0; i < activeprocs; i++)
+  for (pcb_t *p = proc_list; p != NULL; p = p->next)
   {
-    if (i != next)
+    if (p != next)
     {
-      procTab[i].age += 1;
+      p->age += 1;
     }
   }
 
-  // finding out which process is the current executing one
-  for (int i = 0; i < activeprocs; i++)
+  kdata_begin();
+  kdata->runnable = runnable;
+  kdata_end();
+
+  //doing the dispatch
+  dispatch(ctx, current, next);
+  if (current->status == STATUS_EXECUTING)
+    current->status = STATUS_READY; //update execution status of current
+  next->status = STATUS_EXECUTING;  //update execution status of next
+
+  // the address space of an exited process is only unused once switched away from
+  if (((current->status == STATUS_ZOMBIE) || (current->status == STATUS_TERMINATED)) && (current->as != NULL))
   {
-    if (executing->pid == procTab[i].pid)
-    {
-      current = i;
-    }
+    vm_as_put(current->as);
+    current->as = NULL;
   }
 
-  //doing the dispatch
-  dispatch(ctx, &procTab[current], &procTab[next]);
-  if (procTab[current].status == STATUS_EXECUTING)
-    (procTab[current].status == STATUS_READY); //update execution status of current
-  procTab[next].status = STATUS_EXECUTING;     //update execution status of next
+  // a terminated process can only be deallocated once switched away from
+  if (current->status == STATUS_TERMINATED)
+  {
+    proc_free(current);
+  }
+
+  need_resched = false;
 
   return;
 }
 
-extern void main_console();
-extern uint32_t tos_console;
-extern uint32_t tos_general;
+/* A blocking system call sleeps by marking the executing process waiting
+ * on some channel (i.e., the address of whatever it waits for), then
+ * winding the PC back to the svc instruction: once woken, the process
+ * simply makes the same system call again, so the kernel need not keep
+ * any per-process state while it waits.
+ */
 
-void hilevel_handler_rst(ctx_t *ctx)
+void sleep_on(ctx_t *ctx, void *chan)
 {
-  
-  PL011_putc(UART0, 'A', true);
-  TIMER0->Timer1Load = 0x00100000;  // select period = 2^20 ticks ~= 1 sec
-  TIMER0->Timer1Ctrl = 0x00000002;  // select 32-bit   timer
-  TIMER0->Timer1Ctrl |= 0x00000040; // select periodic timer
-  TIMER0->Timer1Ctrl |= 0x00000020; // enable          timer interrupt
-  TIMER0->Timer1Ctrl |= 0x00000080; // enable          timer
-
-  GICC0->PMR = 0x000000F0;         // unmask all            interrupts
-  GICD0->ISENABLER1 |= 0x00000010; // enable timer          interrupt
-  GICC0->CTLR = 0x00000001;        // enable GIC interface
-  GICD0->CTLR = 0x00000001;        // enable GIC distributor
+  executing->status = STATUS_WAITING;
+  executing->wchan = chan;
+  ctx->pc -= 4;
+  need_resched = true;
+}
 
-  int_enable_irq();
+void wakeup(void *chan)
+{
+  for (pcb_t *p = proc_list; p != NULL; p = p->next)
+  {
+    if ((p->status == STATUS_WAITING) && (p->wchan == chan))
+    {
+      p->status = STATUS_READY;
+      p->wchan = NULL;
+      need_resched = true;
+    }
+  }
+}
 
-  /* Invalidate all entries in the process table, so it's clear they are not
-   * representing valid (i.e., active) processes.
-   */
+/* Each process (other than the console) executes on a stack of its own
+ * size, between STACK_DEFAULT and STACK_MAX bytes: it is reserved as a
+ * region just below USER_STACK_TOP in the address space of the process,
+ * so a forked child finds its stack at the same address as the parent did
+ * (and shares it copy-on-write).  Pages are only committed as the stack
+ * grows down into them, so the size is a limit rather than a cost.  No
+ * region lies immediately below a stack, so an overflow raises a data
+ * abort rather than silently writing into something else.  Kernel
+ * threads have no address space, so each of them executes on a physically
+ * contiguous block instead.
+ *
+ * A new stack is painted, i.e., filled with STACK_PAINT, so the high-water
+ * mark (i.e., the most stack a process has used) can be found later by
+ * scanning up from the bottom for the first word that differs.
+ */
 
-  for (int i = 0; i < MAX_PROCS; i++)
+uint32_t stack_round(uint32_t n)
+{
+  if (n == 0)
   {
-    procTab[i].status = STATUS_INVALID;
+    return STACK_DEFAULT;
   }
 
-  /* Automatically execute the user programs P1 and P2 by setting the fields
-   * in two associated PCBs.  Note in each case that
-   *    
-   * - the CPSR value of 0x50 means the processor is switched into USR mode, 
-   *   with IRQ interrupts enabled, and
-   * - the PC and SP values match the entry point and top of stack. 
-   */
+  n = (n + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+  return (n > STACK_MAX) ? STACK_MAX : n;
+}
 
-  for (int i = 0; i < 3; i++)
+void stack_paint(uint32_t *x, uint32_t n)
+{
+  for (uint32_t i = 0; i < (n / sizeof(uint32_t)); i++)
   {
-    fdtable[i].free = false;
+    x[i] = STACK_PAINT;
   }
+}
+
+bool stack_alloc(pcb_t *pcb, uint32_t n)
+{
+  n = stack_round(n);
+  pcb->stack = page_alloc(page_order(n));
 
-  for (int i = 3; i < MAX_FDS; i++)
+  if (pcb->stack == 0)
   {
-    fdtable[i].free = true;
+    return false;
   }
 
-  memset(&procTab[0], 0, sizeof(pcb_t)); // initialise 0-th PCB
-  procTab[0].pid = 0;
-  procTab[0].status = STATUS_READY;
-  procTab[0].tos = (uint32_t)(&tos_console);
-  procTab[0].ctx.cpsr = 0x50;
-  procTab[0].ctx.pc = (uint32_t)(&main_console);
-  procTab[0].ctx.sp = (uint32_t)(&tos_console);
-  procTab[0].priority = 15;
-  procTab[0].age = 0;
-  procTab[0].niceness = 0;
+  stack_paint((uint32_t *)(pcb->stack), n);
 
-  dispatch(ctx, NULL, &procTab[0]);
+  pcb->stack_size = n;
+  pcb->tos = pcb->stack + n;
 
-  return;
+  return true;
 }
 
-void hilevel_handler_irq(ctx_t *ctx)
+bool stack_map(pcb_t *pcb, uint32_t n)
 {
-  // Step 2: read  the interrupt identifier so we know the source.
-
-  uint32_t id = GICC0->IAR;
+  n = stack_round(n);
 
-  // Step 4: handle the interrupt, then clear (or reset) the source.
-
-  if (id == GIC_SOURCE_TIMER0)
+  // each page is painted as it is committed
+  if (!vm_region_add(pcb->as, USER_STACK_TOP - n, USER_STACK_TOP, STACK_PAINT, false))
   {
-    TIMER0->Timer1IntClr = 0x01;
-    schedule(ctx);
+    return false;
   }
 
-  // Step 5: write the interrupt identifier to signal we're done.
+  pcb->stack_size = n;
+  pcb->tos = USER_STACK_TOP;
 
-  GICC0->EOIR = id;
-
-  return;
+  return true;
 }
 
-void hilevel_handler_svc(ctx_t *ctx, uint32_t id)
+void stack_free(pcb_t *pcb)
 {
-  /* Based on the identifier (i.e., the immediate operand) extracted from the
-   * svc instruction, 
-   *
-   * - read  the arguments from preserved usr mode registers,
-   * - perform whatever is appropriate for this system call, then
-   * - write any return value back to preserved usr mode registers.
-   */
-
-  switch (id)
+  if (pcb->stack != 0)
   {
-  case 0x00:
-  { // 0x00 => yield()
-    PL011_putc(UART0, 'Y', true);
-    schedule(ctx);
-
-    break;
+    page_put(pcb->stack);
+    pcb->stack = 0;
   }
+}
 
-  case 0x01:
-  { // 0x01 => write( fd, x, n )
-    //PL011_putc(UART0, 'W', true);
-    int fd = (int)(ctx->gpr[0]);
-    char *x = (char *)(ctx->gpr[1]);
-    int n = (int)(ctx->gpr[2]);
+uint32_t stack_hwm(pcb_t *pcb)
+{
+  for (uint32_t va = pcb->tos - pcb->stack_size; va < pcb->tos; va += PAGE_SIZE)
+  {
+    uint32_t *x = (uint32_t *)(va);
 
-    if (fd == 0)
-    {
-      ctx->gpr[0] = 0;
-    }
-    else if (fd == 1)
+    // a process stack is mapped in its own address space, which may not be the current one
+    if (pcb->as != NULL)
     {
-      for (int i = 0; i < n; i++)
+      uint32_t *pte = vm_pte(pcb->as, va, false);
+
+      if ((pte != NULL) && PTE_L2_SWAPPED(*pte))
       {
-        PL011_putc(UART0, *x++, true);
+        return pcb->tos - va; // i.e., assume all of a swapped page was used
+      }
+      if ((pte == NULL) || !PTE_L2_FRAME(*pte))
+      {
+        continue;
       }
-      ctx->gpr[0] = n;
-    }
-    else if (fd < 0)
-    {
-      ctx->gpr[0] = -1; //error
-    }
-    else if (fd == 2)
-    {
-      ctx->gpr[0] = -1; //error
-    }
-    else
-    {
 
-      pipe_t *pipe_main = fdtable[fd].file;
+      x = (uint32_t *)(*pte & ~(PAGE_SIZE - 1));
+    }
 
-      for (int i = 0; i < n; i++)
+    for (uint32_t i = 0; i < (PAGE_SIZE / sizeof(uint32_t)); i++)
+    {
+      if (x[i] != STACK_PAINT)
       {
-        if (pipe_main->length == buffersize)
-        {
-          break;
-        }
-        else if (pipe_main->length < buffersize)
-        {
-          pipe_main->buffer[pipe_main->head] = *x;
-          pipe_main->head = (pipe_main->head + 1) % buffersize;
-          pipe_main->length++;
-          x++;
-        }
-        ctx->gpr[0] = i;
+        return pcb->tos - (va + (i * sizeof(uint32_t)));
       }
     }
-    break;
   }
 
-  case 0x02:
-  { // 0x02 => read (fd, x, n)
-    //PL011_putc(UART0, 'R', true);
-    int fd = (int)(ctx->gpr[0]);
-    char *x = (char *)(ctx->gpr[1]);
-    int n = (int)(ctx->gpr[2]);
+  return 0;
+}
+
+/* Each file descriptor refers to a pipe (other than the standard ones, for
+ * which file is NULL), which is deallocated once no descriptor refers to
+ * it any longer.  The pipe also counts those referring to its write end,
+ * so a read can tell a pipe that is empty for now from one that no one
+ * can write to again.
+ */
+
+bool fd_valid(pcb_t *pcb, int fd)
+{
+  return (fd >= 0) && (fd < MAX_FDS) && !pcb->files->fds[fd].free;
+}
+
+void fd_inherit(pcb_t *child, pcb_t *parent, int n)
+{
+  for (int fd = 0; fd < n; fd++)
+  {
+    child->files->fds[fd] = parent->files->fds[fd];
 
-    if (fd == 0)
+    if (!child->files->fds[fd].free && (child->files->fds[fd].file != NULL))
     {
-      ctx->gpr[0] = 0;
+      child->files->fds[fd].file->refs++;
+      child->files->fds[fd].file->writers += child->files->fds[fd].writer;
     }
-    else if (fd == 1)
+  }
+}
+
+void fd_close(pcb_t *pcb, int fd)
+{
+  pipe_t *pipe = pcb->files->fds[fd].file;
+
+  if ((pipe != NULL) && pcb->files->fds[fd].writer)
+  {
+    pipe->writers--;
+  }
+
+  pcb->files->fds[fd].free = true;
+  pcb->files->fds[fd].file = NULL;
+  pcb->files->fds[fd].writer = false;
+
+  if ((pipe != NULL) && (--pipe->refs == 0))
+  {
+    for (int i = 0; i < pipe->count; i++)
     {
-      ctx->gpr[0] = 0;
+      page_put(pipe->pages[(pipe->first + i) % PIPE_PAGES]);
     }
-    else if (fd < 0)
+
+    page_put((uint32_t)(pipe->buffer));
+    slab_free(&pipe_cache, pipe);
+  }
+}
+
+/* A write of whole pages from a page-aligned address lends them to the
+ * pipe rather than copying them (see vm_page_lend), and a read of whole
+ * pages into a page-aligned address maps them in place of the reader's
+ * own (cf. vmsplice), so a bulk transfer copies nothing at all.  Lent
+ * pages are queued after whatever is in the buffer, so to keep the bytes
+ * in order a write is only copied into the buffer while no pages are
+ * queued, and a read that cannot take the first page whole (i.e., is too
+ * small or unaligned) copies it into the then empty buffer instead.
+ */
+
+int pipe_lend(pipe_t *pipe, as_t *as, uint32_t x, int n)
+{
+  int r = 0;
+
+  while ((pipe->count < PIPE_PAGES) && ((n - r) >= PAGE_SIZE))
+  {
+    uint32_t pa = vm_page_lend(as, x + r);
+
+    if (pa == 0)
     {
-      ctx->gpr[0] = -1; //error
+      break;
     }
-    else if (fd == 2)
+
+    pipe->pages[(pipe->first + pipe->count) % PIPE_PAGES] = pa;
+    pipe->count++;
+    r += PAGE_SIZE;
+  }
+
+  return r;
+}
+
+int pipe_flip(pipe_t *pipe, as_t *as, uint32_t x, int n)
+{
+  int r = 0;
+
+  if (pipe->length != 0)
+  {
+    return 0;
+  }
+
+  while ((pipe->count > 0) && ((n - r) >= PAGE_SIZE))
+  {
+    if (!vm_page_flip(as, x + r, pipe->pages[pipe->first]))
     {
-      ctx->gpr[0] = -1; //error
+      break;
     }
-    else
-    {
-      pipe_t *pipe_main = fdtable[fd].file;
 
-      for (int i = 0; i < n; i++)
-      {
-        if (pipe_main->length == 0)
-        {
-          break;
-        }
-        else if (pipe_main->length > 0)
-        {
-          *(x + i) = pipe_main->buffer[pipe_main->tail];
-          pipe_main->tail = (pipe_main->tail + 1) % buffersize;
-          pipe_main->length--;
-        }
-        ctx->gpr[0] = i;
-      }
-    }
-    break;
+    pipe->first = (pipe->first + 1) % PIPE_PAGES;
+    pipe->count--;
+    r += PAGE_SIZE;
   }
 
-  case 0x03:
-  { // 0x03 => fork
-    PL011_putc(UART0, 'F', true);
-    int child = -1;
+  if ((r == 0) && (pipe->count > 0))
+  {
+    uint32_t pa = pipe->pages[pipe->first];
+
+    memcpy(pipe->buffer, (void *)(pa), PAGE_SIZE);
+    page_put(pa);
+
+    pipe->first = (pipe->first + 1) % PIPE_PAGES;
+    pipe->count--;
+    pipe->head = PAGE_SIZE % pipe->size;
+    pipe->tail = 0;
+    pipe->length = PAGE_SIZE;
+  }
+
+  return r;
+}
+
+/* Reads and writes never block here: each moves what it can (perhaps
+ * nothing) and returns how many bytes that was, or -1 for an invalid fd,
+ * leaving the caller to decide whether to wait and retry.  A read of an
+ * empty pipe with no write end left open also returns -1, i.e., end of
+ * file, since then waiting would never end.
+ */
 
-    for (int i = 1; i < MAX_PROCS; i++)
+int fd_write(pcb_t *pcb, int fd, char *x, int n)
+{
+  if (fd == 0)
+  {
+    return 0;
+  }
+  else if (!vm_user(pcb->as, (uint32_t)(x), n, false))
+  {
+    return -1; //error
+  }
+  else if (fd == 1)
+  {
+    for (int i = 0; i < n; i++)
     {
-      if (procTab[i].status == STATUS_TERMINATED)
-      {
-        child = i;
-        break;
-      }
+      PL011_putc(UART0, x[i], true);
     }
+    return n;
+  }
+  else if ((fd < 0) || (fd == 2) || !fd_valid(pcb, fd))
+  {
+    return -1; //error
+  }
 
-    if (child == -1)
+  pipe_t *pipe_main = pcb->files->fds[fd].file;
+  int i = pipe_lend(pipe_main, pcb->as, (uint32_t)(x), n);
+
+  // bytes may only be copied in behind the buffer, not behind lent pages
+  for (; (i < n) && (pipe_main->count == 0); i++)
+  {
+    if (pipe_main->length == pipe_main->size)
     {
-      memset(&procTab[activeprocs], 0, sizeof(pcb_t)); // initialise child PCB
-      procTab[activeprocs].tos = (uint32_t)(&tos_general) - (stack_offset * (activeprocs - 1));
-      child = activeprocs;
+      break;
     }
 
-    activeprocs++;
+    pipe_main->buffer[pipe_main->head] = x[i];
+    pipe_main->head = (pipe_main->head + 1) % pipe_main->size;
+    pipe_main->length++;
+  }
+
+  return i;
+}
 
-    procTab[child].pid = (pid_t)(child);
-    procTab[child].status = STATUS_READY;
-    procTab[child].priority = 15;
-    procTab[child].age = 0;
-    procTab[child].niceness = executing->niceness;
-    memcpy(&procTab[child].ctx, ctx, sizeof(ctx_t));
+int fd_read(pcb_t *pcb, int fd, char *x, int n)
+{
+  if (!vm_user(pcb->as, (uint32_t)(x), n, true))
+  {
+    return -1; //error
+  }
+  else if (fd == 0)
+  {
+    return fiq_read((uint8_t *)x, n);
+  }
+  else if (fd == 1)
+  {
+    return 0;
+  }
+  else if ((fd < 0) || (fd == 2) || !fd_valid(pcb, fd))
+  {
+    return -1; //error
+  }
 
-    uint32_t size = (uint32_t)executing->tos - (uint32_t)executing->ctx.sp;
-    procTab[child].ctx.sp = procTab[child].tos - size;
-    memcpy((uint32_t *)(procTab[child].ctx.sp), (uint32_t *)ctx->sp, size);
+  pipe_t *pipe_main = pcb->files->fds[fd].file;
+  int i = pipe_flip(pipe_main, pcb->as, (uint32_t)(x), n);
 
-    ctx->gpr[0] = procTab[child].pid;
-    procTab[child].ctx.gpr[0] = 0;
+  for (; (i < n) && (pipe_main->length > 0); i++)
+  {
+    x[i] = pipe_main->buffer[pipe_main->tail];
+    pipe_main->tail = (pipe_main->tail + 1) % pipe_main->size;
+    pipe_main->length--;
+  }
 
-    break;
+  if ((i == 0) && (n > 0) && (pipe_main->writers == 0))
+  {
+    return -1; // i.e., end of file
   }
 
-  case 0x04:
-  { //exit
-  //can be tested using P5 
-    PL011_putc(UART0, 'E', true);
-    executing->status = STATUS_TERMINATED;
-    ctx->gpr[0];
-    schedule(ctx);
+  return i;
+}
 
-    break;
+/* A vectored transfer moves each segment in turn, straight between it and
+ * the UART or pipe (so with no gather into a staging buffer first), and
+ * stops at the first one that is not moved in full: the total is then
+ * what a single write or read of the segments laid end to end would have
+ * returned.
+ */
+
+int fd_writev(pcb_t *pcb, int fd, iovec_t *iov, int n)
+{
+  int r = 0;
+
+  if ((n < 0) || (n > IOV_MAX) || !vm_user(pcb->as, (uint32_t)(iov), n * sizeof(iovec_t), false))
+  {
+    return -1; //error
   }
 
-  case 0x05:
-  { //exec
-    PL011_putc(UART0, 'X', true);
-    // read pointer to the entry point
-    ctx->pc = (uint32_t)(ctx->gpr[0]);
+  for (int i = 0; i < n; i++)
+  {
+    int k = fd_write(pcb, fd, (char *)(iov[i].base), iov[i].len);
 
-    // reset stack pointer
-    ctx->sp = executing->tos;
+    if (k < 0)
+    {
+      return -1; //error
+    }
 
-    break;
+    r += k;
+
+    if (k < iov[i].len)
+    {
+      break;
+    }
   }
 
-  case 0x06:
-  { //kill
-    PL011_putc(UART0, 'K', true);
-    int i = (int)(ctx->gpr[0]);
-    procTab[i].status = STATUS_TERMINATED;
+  return r;
+}
 
-    schedule(ctx);
+int fd_readv(pcb_t *pcb, int fd, iovec_t *iov, int n)
+{
+  int r = 0;
 
-    break;
+  if ((n < 0) || (n > IOV_MAX) || !vm_user(pcb->as, (uint32_t)(iov), n * sizeof(iovec_t), false))
+  {
+    return -1; //error
   }
 
-  case 0x07:
-  { // nice(pid_t pid, int x)
-    pid_t pid = ctx->gpr[0];
-    int x = ctx->gpr[1];
-
-    //-20 is highest priority, whilst 19 is the lowest;
-    // however, as I have done my priority so that a higher value means a higher priority
-    // I will be doing this the other way round, with 19 highest, -20 lowest
+  for (int i = 0; i < n; i++)
+  {
+    int k = fd_read(pcb, fd, (char *)(iov[i].base), iov[i].len);
 
-    if (x > 19)
+    if (k < 0)
     {
-      x = 19;
+      return (r > 0) ? r : -1; // i.e., end of file after earlier segments
     }
-    if (x < -20)
+
+    r += k;
+
+    if (k < iov[i].len)
     {
-      x = -20;
+      break;
+    }
+  }
+
+  return r;
+}
+
+int fd_poll(pcb_t *pcb, int fd)
+{
+  if (fd == 0)
+  {
+    return fiq_ring.head - fiq_ring.tail;
+  }
+  else if ((fd < 3) || !fd_valid(pcb, fd))
+  {
+    return -1; //error
+  }
+
+  pipe_t *pipe_main = pcb->files->fds[fd].file;
+
+  return pipe_main->length + (pipe_main->count * PAGE_SIZE);
+}
+
+/* When a process exits, everything it owns is reclaimed straight away, i.e.,
+ * its stack and file descriptors: only the PCB remains, as a zombie, until
+ * the parent collects the exit status via waitpid.  Any children are given
+ * to init (i.e., the console).  A process without a parent is deallocated
+ * immediately instead, or by schedule once switched away from if it is
+ * the executing one.
+ */
+
+void proc_exit(pcb_t *pcb, int x)
+{
+  // a table shared with other threads stays open for them
+  for (int fd = 0; (fd < MAX_FDS) && (pcb->files->refs == 1); fd++)
+  {
+    if (!pcb->files->fds[fd].free)
+    {
+      fd_close(pcb, fd);
+    }
+  }
+
+  fd_table_put(pcb);
+  ring_free(pcb);
+
+  stack_free(pcb);
+
+  if ((pcb != executing) && (pcb->as != NULL))
+  {
+    vm_as_put(pcb->as);
+    pcb->as = NULL;
+  }
+
+  for (pcb_t *p = proc_list, *q; p != NULL; p = q)
+  {
+    q = p->next;
+
+    if (p->parent == pcb)
+    {
+      p->parent = (pcb != init) ? init : NULL;
+
+      if (p->status == STATUS_ZOMBIE)
+      {
+        if (p->parent != NULL)
+        {
+          wakeup(p->parent);
+        }
+        else
+        {
+          proc_free(p);
+        }
+      }
+    }
+  }
+
+  pcb->exit_status = x;
+
+  // any thread of the group may be waiting for a thread, not just the parent
+  if (pcb->tgid != pcb->pid)
+  {
+    for (pcb_t *p = proc_list; p != NULL; p = p->next)
+    {
+      if ((p->tgid == pcb->tgid) && (p != pcb))
+      {
+        wakeup(p);
+      }
+    }
+  }
+
+  if (pcb->parent != NULL)
+  {
+    pcb->status = STATUS_ZOMBIE;
+    wakeup(pcb->parent);
+  }
+  else
+  {
+    pcb->status = STATUS_TERMINATED;
+
+    if (pcb != executing)
+    {
+      proc_free(pcb);
+    }
+  }
+
+  if (pcb == executing)
+  {
+    need_resched = true;
+  }
+}
+
+/* spawn creates a process directly from an entry point, rather than via
+ * fork then exec: the child starts from a pristine program image and an
+ * empty stack, so nothing of the parent (e.g., its live stack) is shared
+ * or copied only to be thrown away, and it takes one kernel entry rather
+ * than two.  spawnv creates a batch of processes in one kernel entry too.
+ */
+
+pcb_t *proc_spawn(pcb_t *parent, uint32_t entry, uint32_t *args, spawn_attr_t *attrs)
+{
+  pcb_t *pcb = proc_alloc();
+
+  if (pcb == NULL)
+  {
+    return NULL;
+  }
+
+  pcb->as = vm_as_create();
+
+  if ((pcb->as == NULL) || !vm_as_exec(pcb->as) || !stack_map(pcb, (attrs != NULL) ? attrs->stack : 0))
+  {
+    if (pcb->as != NULL)
+    {
+      vm_as_put(pcb->as);
+    }
+    proc_free(pcb);
+    return NULL;
+  }
+
+  fd_inherit(pcb, parent, ((attrs != NULL) && (attrs->flags & SPAWN_FDS)) ? MAX_FDS : 3);
+
+  for (int i = 0; i < SPAWN_ARGS; i++)
+  {
+    pcb->ctx.gpr[i] = (args != NULL) ? args[i] : 0;
+  }
+
+  pcb->parent = parent;
+  pcb->status = STATUS_READY;
+  pcb->ctx.cpsr = CPSR_USR;
+  pcb->ctx.pc = entry;
+  pcb->ctx.sp = pcb->tos;
+  pcb->priority = 15;
+  pcb->age = 0;
+  pcb->niceness = parent->niceness;
+
+  // a user process never outranks a kernel thread, nor sinks to idle
+  if ((attrs != NULL) && (attrs->flags & SPAWN_PRIORITY))
+  {
+    pcb->priority = (attrs->priority < 1) ? 1 : (attrs->priority > 15) ? 15 : attrs->priority;
+  }
+  if ((attrs != NULL) && (attrs->flags & SPAWN_NICE))
+  {
+    pcb->niceness = (attrs->niceness < -20) ? -20 : (attrs->niceness > 19) ? 19 : attrs->niceness;
+  }
+
+  return pcb;
+}
+
+/* clone creates a thread, i.e., a process that starts at some entry point
+ * on a stack the caller provides, but shares whatever flags asks for with
+ * the parent: CLONE_VM shares the address space (which is otherwise copied,
+ * as per fork), CLONE_FILES the file descriptor table (otherwise each fd is
+ * inherited, as per fork), and CLONE_THREAD puts it in the thread group of
+ * the parent, so any thread in the group can waitpid for it.  Each thread
+ * has its own thread pointer, which dispatch loads into TPIDRURO (so user
+ * mode can read but not write it); CLONE_SETTLS sets it to the argument
+ * passed in r0, rather than to that of the parent.
+ */
+
+pcb_t *proc_clone(pcb_t *parent, uint32_t entry, uint32_t stack, uint32_t flags, uint32_t x)
+{
+  pcb_t *pcb = proc_alloc();
+
+  if (pcb == NULL)
+  {
+    return NULL;
+  }
+
+  if (flags & CLONE_VM)
+  {
+    vm_as_get(parent->as);
+    pcb->as = parent->as;
+  }
+  else
+  {
+    pcb->as = vm_as_create();
+
+    if ((pcb->as == NULL) || !vm_region_copy(pcb->as, parent->as) || !vm_as_share(pcb->as, parent->as))
+    {
+      if (pcb->as != NULL)
+      {
+        vm_as_put(pcb->as);
+      }
+      proc_free(pcb);
+      return NULL;
+    }
+  }
+
+  if (flags & CLONE_FILES)
+  {
+    fd_table_share(pcb, parent);
+  }
+  else
+  {
+    fd_inherit(pcb, parent, MAX_FDS);
+  }
+
+  pcb->parent = parent;
+  pcb->tgid = (flags & CLONE_THREAD) ? parent->tgid : pcb->pid;
+  pcb->tls = (flags & CLONE_SETTLS) ? x : parent->tls;
+  pcb->status = STATUS_READY;
+  pcb->ctx.cpsr = CPSR_USR;
+  pcb->ctx.pc = entry;
+  pcb->ctx.sp = stack;
+  pcb->ctx.gpr[0] = x;
+  pcb->tos = stack; // i.e., stack_size = 0, since the caller manages the stack
+  pcb->priority = 15;
+  pcb->age = 0;
+  pcb->niceness = parent->niceness;
+
+  return pcb;
+}
+
+pcb_t *kthread_create(void (*entry)(), int priority)
+{
+  pcb_t *pcb = proc_alloc();
+
+  if (pcb == NULL)
+  {
+    return NULL;
+  }
+  if (!stack_alloc(pcb, KTHREAD_STACK))
+  {
+    proc_free(pcb);
+    return NULL;
+  }
+
+  pcb->status = STATUS_READY;
+  pcb->ctx.cpsr = CPSR_KTHREAD;
+  pcb->ctx.pc = (uint32_t)(entry);
+  pcb->ctx.sp = pcb->tos;
+  pcb->priority = priority;
+  pcb->age = 0;
+  pcb->niceness = 0;
+
+  return pcb;
+}
+
+void idle_main()
+{
+  while (true)
+  {
+    asm volatile("wfi \n"); // wait for interrupt
+  }
+}
+
+void kthread_yield()
+{
+  asm volatile("svc #0x00 \n" // make system call SYS_YIELD
+               :
+               :
+               : "memory");
+}
+
+/* The timer top half only acknowledges the interrupt and raises tick_work,
+ * which then counts the tick and requests a reschedule: the actual switch
+ * happens in return_to_thread, with the deferred work done first.
+ */
+
+void tick(void *arg)
+{
+  ticks++;
+  kdata_clock();
+  need_resched = true;
+
+  swap_balance();
+}
+
+void timer_irq(uint32_t id)
+{
+  TIMER0->Timer1IntClr = 0x01;
+  softirq_raise(&tick_work);
+}
+
+void return_to_thread(ctx_t *ctx)
+{
+  uint32_t mode = ctx->cpsr & CPSR_MODE;
+
+  // a nested interrupt returns into the kernel, so leave deferred work and
+  // rescheduling to whichever handler eventually returns to thread context
+  if ((mode != CPSR_MODE_USR) && (mode != CPSR_MODE_SYS))
+  {
+    return;
+  }
+
+  while (work_pending(&softirq_queue))
+  {
+    work_run(&softirq_queue);
+    int_unable_irq();
+  }
+
+  // a reschedule requested while preemption is disabled stays pending, and
+  // is done on the first return once it is enabled again
+  if (need_resched && (preempt_count == 0))
+  {
+    schedule(ctx);
+  }
+
+  // the executing process is about to resume, so its address space is
+  // current: retry pending ring operations, and consume entries iff. polled
+  if ((executing->ring != NULL) && ((ctx->cpsr & CPSR_MODE) == CPSR_MODE_USR))
+  {
+    ring_process(executing, (executing->ring->flags & RING_SETUP_POLL) != 0);
+  }
+
+  return;
+}
+
+extern void main_console();
+
+void hilevel_handler_rst(ctx_t *ctx)
+{
+  
+  vm_init();
+  page_init(RAM_BASE, RAM_SIZE); // per QEMU -m option
+  vm_image_init();
+  swap_init();
+
+  PL011_putc(UART0, 'A', true);
+  work_init(&tick_work, tick, NULL);
+
+  TIMER0->Timer1Load = 0x00100000;  // select period = 2^20 ticks ~= 1 sec
+  TIMER0->Timer1Ctrl = 0x00000002;  // select 32-bit   timer
+  TIMER0->Timer1Ctrl |= 0x00000040; // select periodic timer
+  TIMER0->Timer1Ctrl |= 0x00000020; // enable          timer interrupt
+  TIMER0->Timer1Ctrl |= 0x00000080; // enable          timer
+
+  irq_init();
+  irq_register(GIC_SOURCE_TIMER0, timer_irq, IRQ_PRIORITY_TIMER, IRQ_AFFINITY_CPU0);
+  fiq_init();
+
+  if (FIQ_MEASURE > 0)
+  {
+    fiq_measure(FIQ_MEASURE);
+  }
+
+  int_enable_irq();
+  int_enable_fiq();
+
+  /* Automatically execute the user programs P1 and P2 by setting the fields
+   * in two associated PCBs.  Note in each case that
+   *    
+   * - the CPSR value of 0x10 means the processor is switched into USR mode, 
+   *   with IRQ and FIQ interrupts enabled, and
+   * - the PC and SP values match the entry point and top of stack. 
+   */
+
+  pcb_t *console = proc_alloc(); // initialise 0-th PCB
+  console->as = vm_as_create();
+  vm_as_exec(console->as);
+  stack_map(console, CONSOLE_STACK);
+  console->status = STATUS_READY;
+  console->ctx.cpsr = CPSR_USR;
+  console->ctx.pc = (uint32_t)(&main_console);
+  console->ctx.sp = console->tos;
+  console->priority = 15;
+  console->age = 0;
+  console->niceness = 0;
+
+  for (int fd = 0; fd < MAX_FDS; fd++)
+  {
+    console->files->fds[fd].free = (fd > 2); // 0, 1 and 2 are standard
+    console->files->fds[fd].file = NULL;
+    console->files->fds[fd].writer = false;
+  }
+
+  init = console;
+
+  kworker = kthread_create(kworker_main, 20);
+  idle = kthread_create(idle_main, 0);
+
+  dispatch(ctx, NULL, console);
+
+  return;
+}
+
+void hilevel_handler_irq(ctx_t *ctx)
+{
+  // Step 2-5: acknowledge, handle and complete the interrupt.
+
+  irq_dispatch();
+
+  // Step 6: execute deferred work, and reschedule if need be.
+
+  return_to_thread(ctx);
+
+  return;
+}
+
+/* A data abort is either a copy-on-write fault or a first access to a page
+ * in some region, which vm_fault resolves so the access can simply be
+ * retried, or an access the process has no right to make, in which case
+ * it exits as if killed by SIG_SEGV.  The kernel has no way to recover
+ * from such an access of its own, so it halts: every system call checks
+ * (via vm_user) any user memory it accesses before doing so, so only a
+ * kernel bug (or running out of frames mid-access) can get here.  User
+ * pages are never executable, so a prefetch abort is always of the latter
+ * kind.
+ */
+
+void hilevel_fault(ctx_t *ctx, uint32_t far)
+{
+  if ((ctx->cpsr & CPSR_MODE) != CPSR_MODE_USR)
+  {
+    PL011_putc(UART0, '\n', true);
+    PL011_putc(UART0, '!', true);
+    for (int j = 24; j >= 0; j -= 8)
+    {
+      PL011_puth(UART0, (far >> j) & 0xFF, true);
+    }
+    PL011_putc(UART0, '\n', true);
+
+    while (1)
+    {
+      continue;
+    }
+  }
+
+  PL011_putc(UART0, 'S', true);
+  proc_exit(executing, 128 + SIG_SEGV);
+
+  return_to_thread(ctx);
+
+  return;
+}
+
+void hilevel_handler_pabt(ctx_t *ctx)
+{
+  hilevel_fault(ctx, mmu_get_ifar());
+
+  return;
+}
+
+void hilevel_handler_dabt(ctx_t *ctx)
+{
+  uint32_t fsr = mmu_get_dfsr();
+  uint32_t far = mmu_get_dfar();
+  int type = vm_fault(vm_current, far, fsr);
+
+  if (type != VM_FAULT_NONE)
+  {
+    executing->faults[type]++;
+    return_to_thread(ctx);
+    return;
+  }
+
+  hilevel_fault(ctx, far);
+
+  return;
+}
+
+void hilevel_handler_svc(ctx_t *ctx, uint32_t id)
+{
+  /* Based on the identifier (i.e., the immediate operand) extracted from the
+   * svc instruction, 
+   *
+   * - read  the arguments from preserved usr mode registers,
+   * - perform whatever is appropriate for this system call, then
+   * - write any return value back to preserved usr mode registers.
+   */
+
+  switch (id)
+  {
+  case 0x00:
+  { // 0x00 => yield()
+    PL011_putc(UART0, 'Y', true);
+    schedule(ctx);
+
+    break;
+  }
+
+  case 0x01:
+  { // 0x01 => write( fd, x, n )
+    //PL011_putc(UART0, 'W', true);
+    ctx->gpr[0] = fd_write(executing, (int)(ctx->gpr[0]), (char *)(ctx->gpr[1]), (int)(ctx->gpr[2]));
+    break;
+  }
+
+  case 0x02:
+  { // 0x02 => read (fd, x, n)
+    //PL011_putc(UART0, 'R', true);
+    int fd = (int)(ctx->gpr[0]);
+    int n = (int)(ctx->gpr[2]);
+    int r = fd_read(executing, fd, (char *)(ctx->gpr[1]), n);
+
+    // stdin is buffered in fiq_ring (by the FIQ or fallback IRQ handler), so block until it has data
+    if ((fd == 0) && (r == 0) && (n > 0))
+    {
+      sleep_on(ctx, &fiq_ring);
+    }
+    else
+    {
+      ctx->gpr[0] = r;
+    }
+    break;
+  }
+
+  case 0x03:
+  { // 0x03 => fork
+    PL011_putc(UART0, 'F', true);
+    pcb_t *child = proc_alloc();
+
+    if (child == NULL)
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    // everything, including the stack, is shared copy-on-write, and
+    // whatever is not yet committed remains reserved in the child too
+    child->as = vm_as_create();
+
+    if ((child->as == NULL) || !vm_region_copy(child->as, executing->as) || !vm_as_share(child->as, executing->as))
+    {
+      if (child->as != NULL)
+      {
+        vm_as_put(child->as);
+      }
+      proc_free(child);
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    // the child shares every pipe the parent has open
+    fd_inherit(child, executing, MAX_FDS);
+
+    child->parent = executing;
+    child->status = STATUS_READY;
+    child->priority = 15;
+    child->age = 0;
+    child->niceness = executing->niceness;
+    child->tls = executing->tls;
+    child->tos = executing->tos;
+    child->stack_size = executing->stack_size;
+    memcpy(&child->ctx, ctx, sizeof(ctx_t));
+
+    ctx->gpr[0] = child->pid;
+    child->ctx.gpr[0] = 0;
+
+    break;
+  }
+
+  case 0x04:
+  { //exit
+  //can be tested using P5 
+    PL011_putc(UART0, 'E', true);
+    proc_exit(executing, (int)(ctx->gpr[0]));
+
+    break;
+  }
+
+  case 0x05:
+  { // exec( x, n )
+    PL011_putc(UART0, 'X', true);
+    // read pointer to the entry point
+    ctx->pc = (uint32_t)(ctx->gpr[0]);
+
+    // start from pristine (copy-on-write) program data and bss, plus a
+    // fresh stack of n bytes (or of the current size, iff. n = 0)
+    uint32_t n = (uint32_t)(ctx->gpr[1]);
+
+    // a thread leaves the address space to the rest of its group, rather than replace it for them
+    if (executing->as->refs > 1)
+    {
+      as_t *as = vm_as_create();
+
+      if (as == NULL)
+      {
+        proc_exit(executing, 128 + SIG_SEGV);
+        break;
+      }
+
+      vm_as_put(executing->as);
+      executing->as = as;
+      vm_switch(as);
+    }
+
+    executing->tls = 0;
+    mmu_set_tls(0);
+    ring_free(executing);
+
+    if (!vm_as_exec(executing->as) || !stack_map(executing, (n != 0) ? n : executing->stack_size))
+    {
+      proc_exit(executing, 128 + SIG_SEGV);
+    }
+
+    // reset stack pointer
+    ctx->sp = executing->tos;
+
+    break;
+  }
+
+  case 0x06:
+  { //kill
+    PL011_putc(UART0, 'K', true);
+    pcb_t *pcb = proc_lookup((pid_t)(ctx->gpr[0]));
+
+    if ((pcb == NULL) || (pcb == kworker) || (pcb == idle) || (pcb->status == STATUS_ZOMBIE) || (pcb->status == STATUS_TERMINATED))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    // a killed process exits with status 128 + signal, as per a shell
+    ctx->gpr[0] = 0;
+    proc_exit(pcb, 128 + (int)(ctx->gpr[1]));
+
+    break;
+  }
+
+  case 0x07:
+  { // nice(pid_t pid, int x)
+    pid_t pid = ctx->gpr[0];
+    int x = ctx->gpr[1];
+
+    //-20 is highest priority, whilst 19 is the lowest;
+    // however, as I have done my priority so that a higher value means a higher priority
+    // I will be doing this the other way round, with 19 highest, -20 lowest
+
+    if (x > 19)
+    {
+      x = 19;
+    }
+    if (x < -20)
+    {
+      x = -20;
+    }
+    pcb_t *pcb = proc_lookup(pid);
+
+    if (pcb != NULL)
+    {
+      pcb->niceness = x;
     }
-    procTab[pid].niceness = x;
     break;
   }
 
@@ -410,35 +1212,76 @@ void hilevel_handler_svc(ctx_t *ctx, uint32_t id)
     int readfd = -1;
     int writefd = -1;
 
+    if (!vm_user(executing->as, (uint32_t)(pipefds), 2 * sizeof(int), true))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
     //initialise pipe 
-    pipe_t *ps = malloc(sizeof(pipe_t));
+    pipe_t *ps = slab_alloc(&pipe_cache);
+
+    if (ps == NULL)
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    ps->buffer = (char *)(page_alloc(PIPE_ORDER));
+    ps->size = PAGE_SIZE << PIPE_ORDER;
     ps->head = 0;
     ps->tail = 0;
     ps->length = 0;
+    ps->refs = 0;
+    ps->writers = 0;
+    ps->first = 0;
+    ps->count = 0;
+
+    if (ps->buffer == NULL)
+    {
+      slab_free(&pipe_cache, ps);
+      ctx->gpr[0] = -1;
+      break;
+    }
 
     for (int i = 3; i < MAX_FDS; i++)
     {
-      if (fdtable[i].free == true)
+      if (executing->files->fds[i].free == true)
       {
         readfd = i;
-        fdtable[i].free = false;
-        fdtable[i].file = ps;
+        executing->files->fds[i].free = false;
+        executing->files->fds[i].file = ps;
+        executing->files->fds[i].writer = false;
+        ps->refs++;
         break;
       }
     }
 
     for (int i = 3; i < MAX_FDS; i++)
     {
-      if (fdtable[i].free == true)
+      if (executing->files->fds[i].free == true)
       {
         writefd = i;
-        fdtable[i].free = false;
-        fdtable[i].file = ps;
+        executing->files->fds[i].free = false;
+        executing->files->fds[i].file = ps;
+        executing->files->fds[i].writer = true;
+        ps->refs++;
+        ps->writers++;
         break;
       }
     }
     if (readfd == -1 | writefd == -1) // pipe fail
     {
+      if (readfd != -1)
+      {
+        fd_close(executing, readfd); // deallocates pipe as well
+      }
+      else
+      {
+        page_put((uint32_t)(ps->buffer));
+        slab_free(&pipe_cache, ps);
+      }
+
       ctx->gpr[0] = -1;
     }
 
@@ -452,11 +1295,431 @@ void hilevel_handler_svc(ctx_t *ctx, uint32_t id)
     break;
   }
 
+  case 0x09:
+  { // 0x09 => waitpid( pid, status, options )
+    pid_t pid = (pid_t)(ctx->gpr[0]);
+    int *status = (int *)(ctx->gpr[1]);
+    int options = (int)(ctx->gpr[2]);
+
+    if ((status != NULL) && !vm_user(executing->as, (uint32_t)(status), sizeof(int), true))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    bool found = false;
+    pcb_t *zombie = NULL;
+
+    for (pcb_t *p = proc_list; p != NULL; p = p->next)
+    {
+      // i.e., a child, or a thread of the same group (which any thread may join)
+      bool joinable = (p->tgid == executing->tgid) && (p->tgid != p->pid) && (p != executing);
+
+      if (((p->parent == executing) || joinable) && ((pid == -1) || (p->pid == pid)))
+      {
+        found = true;
+
+        if (p->status == STATUS_ZOMBIE)
+        {
+          zombie = p;
+          break;
+        }
+      }
+    }
+
+    if (zombie != NULL)
+    {
+      if (status != NULL)
+      {
+        *status = zombie->exit_status;
+      }
+
+      ctx->gpr[0] = zombie->pid;
+      proc_free(zombie);
+    }
+    else if (!found)
+    {
+      ctx->gpr[0] = -1; // no such child
+    }
+    else if (options & WNOHANG)
+    {
+      ctx->gpr[0] = 0;
+    }
+    else
+    {
+      sleep_on(ctx, executing); // woken by proc_exit of a child
+    }
+    break;
+  }
+
+  case 0x0A:
+  { // 0x0A => close( fd )
+    int fd = (int)(ctx->gpr[0]);
+
+    if (!fd_valid(executing, fd))
+    {
+      ctx->gpr[0] = -1;
+    }
+    else
+    {
+      fd_close(executing, fd);
+      ctx->gpr[0] = 0;
+    }
+    break;
+  }
+
+  case 0x0B:
+  { // 0x0B => meminfo( x, n )
+    uint32_t *x = (uint32_t *)(ctx->gpr[0]);
+    int n = (int)(ctx->gpr[1]);
+
+    n = (n < 0) ? 0 : (n > PAGE_ORDERS) ? PAGE_ORDERS : n;
+
+    if (!vm_user(executing->as, (uint32_t)(x), n * sizeof(uint32_t), true))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    // free block count per order, most useful for spotting fragmentation
+    for (int k = 0; k < n; k++)
+    {
+      x[k] = page_free_count[k];
+    }
+
+    ctx->gpr[0] = PAGE_ORDERS;
+    break;
+  }
+
+  case 0x0C:
+  { // 0x0C => slabinfo( x, n )
+    slab_info_t *x = (slab_info_t *)(ctx->gpr[0]);
+    int n = (int)(ctx->gpr[1]);
+    int caches = slab_info(NULL, 0);
+
+    n = (n < 0) ? 0 : (n > caches) ? caches : n;
+
+    if (!vm_user(executing->as, (uint32_t)(x), n * sizeof(slab_info_t), true))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    ctx->gpr[0] = slab_info(x, n);
+    break;
+  }
+
+  case 0x0D:
+  { // 0x0D => stackinfo( pid, x )
+    pcb_t *pcb = proc_lookup((pid_t)(ctx->gpr[0]));
+    uint32_t *x = (uint32_t *)(ctx->gpr[1]);
+
+    if ((pcb == NULL) || (pcb->status == STATUS_ZOMBIE) || !vm_user(executing->as, (uint32_t)(x), 2 * sizeof(uint32_t), true))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    x[0] = pcb->stack_size;
+    x[1] = stack_hwm(pcb);
+
+    ctx->gpr[0] = 0;
+    break;
+  }
+
+  case 0x0E:
+  { // 0x0E => faultinfo( pid, x )
+    pcb_t *pcb = proc_lookup((pid_t)(ctx->gpr[0]));
+    uint32_t *x = (uint32_t *)(ctx->gpr[1]);
+
+    if ((pcb == NULL) || (pcb->status == STATUS_ZOMBIE) || (pcb->as == NULL) || !vm_user(executing->as, (uint32_t)(x), 5 * sizeof(uint32_t), true))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    x[0] = pcb->faults[VM_FAULT_COW];
+    x[1] = pcb->faults[VM_FAULT_DEMAND];
+    x[2] = pcb->faults[VM_FAULT_MINOR];
+    x[3] = pcb->faults[VM_FAULT_SWAP];
+    x[4] = vm_resident(pcb->as);
+
+    ctx->gpr[0] = 0;
+    break;
+  }
+
+  case 0x0F:
+  { // 0x0F => sbrk( n )
+    uint32_t brk = executing->as->brk;
+    int32_t n = (int32_t)(ctx->gpr[0]);
+
+    // the break only moves within the heap, so reject any wrap around
+    if (((n > 0) && ((brk + n) < brk)) || ((n < 0) && ((brk + n) > brk)) || !vm_brk(executing->as, brk + n))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    ctx->gpr[0] = brk;
+    break;
+  }
+
+  case 0x10:
+  { // 0x10 => mmap( n )
+    uint32_t n = ((uint32_t)(ctx->gpr[0]) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t va = vm_region_gap(executing->as, USER_MMAP_BASE, USER_MMAP_LIMIT, n);
+
+    if ((va == 0) || !vm_region_add(executing->as, va, va + n, 0, false))
+    {
+      ctx->gpr[0] = 0;
+      break;
+    }
+
+    ctx->gpr[0] = va;
+    break;
+  }
+
+  case 0x11:
+  { // 0x11 => munmap( x, n )
+    uint32_t x = (uint32_t)(ctx->gpr[0]);
+    uint32_t n = (uint32_t)(ctx->gpr[1]);
+
+    if ((x & (PAGE_SIZE - 1)) || (x < USER_MMAP_BASE) || (x >= USER_MMAP_LIMIT) || (n > (USER_MMAP_LIMIT - x)) || !vm_region_remove(executing->as, x, x + n))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    ctx->gpr[0] = 0;
+    break;
+  }
+
+  case 0x12:
+  { // 0x12 => shmmap( x, n )
+    uint32_t x = (uint32_t)(ctx->gpr[0]);
+    shm_t *shm = (x != 0) ? shm_lookup(x) : NULL;
+
+    // an existing object is mapped whole, whatever size is asked for
+    if (shm != NULL)
+    {
+      shm_get(shm);
+    }
+    else
+    {
+      shm = shm_create(x, (uint32_t)(ctx->gpr[1]));
+    }
+
+    if (shm == NULL)
+    {
+      ctx->gpr[0] = 0;
+      break;
+    }
+
+    uint32_t va = vm_region_gap(executing->as, USER_MMAP_BASE, USER_MMAP_LIMIT, shm->size);
+
+    if ((va == 0) || !vm_region_map(executing->as, va, va + shm->size, shm, 0))
+    {
+      va = 0;
+    }
+
+    shm_put(shm); // i.e., leaving the region (if any) with the only reference
+
+    ctx->gpr[0] = va;
+    break;
+  }
+
+  case 0x13:
+  { // 0x13 => shmunmap( x )
+    uint32_t x = (uint32_t)(ctx->gpr[0]);
+    vm_region_t *r = vm_region_find(executing->as, x);
+
+    // write back what this mapping dirtied, even if others still map the object
+    if ((r != NULL) && (r->shm != NULL))
+    {
+      shm_sync(r->shm, r->offset >> PAGE_SHIFT, (r->offset + (r->end - r->start)) >> PAGE_SHIFT);
+    }
+
+    if ((r == NULL) || (r->shm == NULL) || !vm_region_remove(executing->as, r->start, r->end))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    ctx->gpr[0] = 0;
+    break;
+  }
+
+  case 0x14:
+  { // 0x14 => spawn( entry, args, attrs )
+    uint32_t *args = (uint32_t *)(ctx->gpr[1]);
+    spawn_attr_t *attrs = (spawn_attr_t *)(ctx->gpr[2]);
+
+    if (((args != NULL) && !vm_user(executing->as, (uint32_t)(args), SPAWN_ARGS * sizeof(uint32_t), false)) ||
+        ((attrs != NULL) && !vm_user(executing->as, (uint32_t)(attrs), sizeof(spawn_attr_t), false)))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    pcb_t *pcb = proc_spawn(executing, ctx->gpr[0], args, attrs);
+
+    ctx->gpr[0] = (pcb != NULL) ? pcb->pid : -1;
+    break;
+  }
+
+  case 0x15:
+  { // 0x15 => spawnv( x, n, attrs )
+    spawn_t *x = (spawn_t *)(ctx->gpr[0]);
+    int n = (int)(ctx->gpr[1]);
+    spawn_attr_t *attrs = (spawn_attr_t *)(ctx->gpr[2]);
+    int r = 0;
+
+    if ((n < 0) || (n > SPAWN_MAX) || !vm_user(executing->as, (uint32_t)(x), n * sizeof(spawn_t), true) ||
+        ((attrs != NULL) && !vm_user(executing->as, (uint32_t)(attrs), sizeof(spawn_attr_t), false)))
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    // once one cannot be created, neither can the rest (e.g., out of PIDs or memory), so stop
+    for (; r < n; r++)
+    {
+      pcb_t *pcb = proc_spawn(executing, x[r].entry, x[r].args, attrs);
+
+      x[r].pid = (pcb != NULL) ? pcb->pid : -1;
+
+      if (pcb == NULL)
+      {
+        break;
+      }
+    }
+
+    ctx->gpr[0] = r;
+    break;
+  }
+
+  case 0x16:
+  { // 0x16 => dmap( a, n )
+    shm_t *shm = shm_create_disk((uint32_t)(ctx->gpr[0]), (uint32_t)(ctx->gpr[1]));
+
+    if (shm == NULL)
+    {
+      ctx->gpr[0] = 0;
+      break;
+    }
+
+    uint32_t va = vm_region_gap(executing->as, USER_MMAP_BASE, USER_MMAP_LIMIT, shm->size);
+
+    if ((va == 0) || !vm_region_map(executing->as, va, va + shm->size, shm, 0))
+    {
+      va = 0;
+    }
+
+    shm_put(shm); // i.e., leaving the region (if any) with the only reference
+
+    ctx->gpr[0] = va;
+    break;
+  }
+
+  case 0x17:
+  { // 0x17 => msync( x, n )
+    uint32_t x = (uint32_t)(ctx->gpr[0]);
+    uint32_t y = x + (uint32_t)(ctx->gpr[1]);
+    int e = (y < x) ? -1 : 0;
+
+    for (vm_region_t *r = executing->as->regions; (r != NULL) && (e == 0); r = r->next)
+    {
+      if ((r->shm == NULL) || (r->end <= x) || (r->start >= y))
+      {
+        continue;
+      }
+
+      uint32_t i = r->offset + (((x > r->start) ? x : r->start) - r->start);
+      uint32_t j = r->offset + (((y < r->end) ? y : r->end) - r->start);
+
+      if (!shm_sync(r->shm, i >> PAGE_SHIFT, (j + PAGE_SIZE - 1) >> PAGE_SHIFT))
+      {
+        e = -1;
+      }
+    }
+
+    ctx->gpr[0] = e;
+    break;
+  }
+
+  case 0x18:
+  { // 0x18 => clone( entry, stack, flags, x )
+    pcb_t *pcb = proc_clone(executing, ctx->gpr[0], ctx->gpr[1], ctx->gpr[2], ctx->gpr[3]);
+
+    ctx->gpr[0] = (pcb != NULL) ? pcb->pid : -1;
+    break;
+  }
+
+  case 0x19:
+  { // 0x19 => ring_setup( flags )
+    ctx->gpr[0] = ring_setup(executing, (uint32_t)(ctx->gpr[0]));
+    break;
+  }
+
+  case 0x1A:
+  { // 0x1A => ring_enter( flags )
+    ring_t *ring = executing->ring;
+    uint32_t flags = (uint32_t)(ctx->gpr[0]);
+
+    if (ring == NULL)
+    {
+      ctx->gpr[0] = -1;
+      break;
+    }
+
+    ring_process(executing, true);
+    ctx->gpr[0] = ring->page->cq_tail - ring->page->cq_head; // i.e., completions to reap
+
+    if (flags & RING_ENTER_YIELD)
+    {
+      schedule(ctx);
+    }
+    break;
+  }
+
+  case 0x1B:
+  { // 0x1B => writev( fd, iov, n )
+    ctx->gpr[0] = fd_writev(executing, (int)(ctx->gpr[0]), (iovec_t *)(ctx->gpr[1]), (int)(ctx->gpr[2]));
+    break;
+  }
+
+  case 0x1C:
+  { // 0x1C => readv( fd, iov, n )
+    int fd = (int)(ctx->gpr[0]);
+    iovec_t *iov = (iovec_t *)(ctx->gpr[1]);
+    int n = (int)(ctx->gpr[2]);
+    int r = fd_readv(executing, fd, iov, n);
+    uint32_t len = 0;
+
+    for (int i = 0; (r == 0) && (i < n); i++)
+    {
+      len += iov[i].len;
+    }
+
+    // as for read, block until stdin has data
+    if ((fd == 0) && (r == 0) && (len > 0))
+    {
+      sleep_on(ctx, &fiq_ring);
+    }
+    else
+    {
+      ctx->gpr[0] = r;
+    }
+    break;
+  }
+
   default:
   { // 0x?? => unknown/unsupported
     break;
   }
   }
 
+  return_to_thread(ctx);
+
   return;
 }
@@ -28,6 +28,16 @@
 
 #include "lolevel.h"
 #include "int.h"
+#include "irq.h"
+#include "fiq.h"
+#include "kdata.h"
+#include "page.h"
+#include "ring.h"
+#include "slab.h"
+#include "shm.h"
+#include "swap.h"
+#include "vm.h"
+#include "work.h"
 
 /* The kernel source code is made simpler and more consistent by using 
  * some human-readable type definitions:
@@ -38,23 +48,64 @@
  *   whether it is currently executing,
  * - a type that captures each component of an execution context (i.e.,
  *   processor state) in a compatible order wrt. the low-level handler
- *   preservation and restoration prologue and epilogue, and
+ *   preservation and restoration prologue and epilogue (i.e., the order
+ *   stmia/ldmia then srsdb/rfeia use), and
  * - a type that captures a process PCB.
  */
 
-#define MAX_PROCS 100
+#define PROC_HASH 1024
 #define MAX_FDS 250
 #define MAX_PIPES 100
-#define buffersize 16
+#define PIPE_ORDER 0 // i.e., pipe buffers are 1 page
+#define PIPE_PAGES 16 // pages a pipe can hold on loan, on top of its buffer
+#define IOV_MAX 16 // segments a readv or writev can name
+
+#define STACK_DEFAULT 0x00010000 // stack limit, unless exec specifies one
+#define STACK_MAX     0x00100000
+#define STACK_PAINT   0x57AC57AC // written to every word of a new stack
+#define CONSOLE_STACK 0x00002000
+#define KTHREAD_STACK 0x00001000
+
+#define WNOHANG 0x01 // waitpid option: return 0 rather than block
+#define SIG_SEGV 0x0B // signal for an access that cannot be resolved
+
+#define SPAWN_ARGS     4    // words passed to a spawned process, in r0-r3
+#define SPAWN_MAX      16   // processes one spawnv can create
+#define SPAWN_FDS      0x01 // spawn attribute: inherit every fd, not just 0, 1 and 2
+#define SPAWN_PRIORITY 0x02 // spawn attribute: use priority given, not default
+#define SPAWN_NICE     0x04 // spawn attribute: use niceness given, not parent's
+
+#define CLONE_VM       0x01 // clone flag: share the address space, rather than copy it
+#define CLONE_FILES    0x02 // clone flag: share the fd table, rather than inherit each fd
+#define CLONE_THREAD   0x04 // clone flag: join the thread group of the parent
+#define CLONE_SETTLS   0x08 // clone flag: set the thread pointer, rather than inherit it
 
 typedef int pid_t;
 
+// attributes for spawn, as passed from user space
+typedef struct
+{
+  uint32_t flags;  // SPAWN_* attributes that apply
+  int priority;    // base priority, between 1 and 15 (iff. SPAWN_PRIORITY)
+  int niceness;    // niceness, between -20 and 19 (iff. SPAWN_NICE)
+  uint32_t stack;  // stack size, or 0 for the default
+} spawn_attr_t;
+
+// one process for spawnv to create, as passed from user space
+typedef struct
+{
+  uint32_t entry;            // entry point
+  uint32_t args[SPAWN_ARGS]; // initial r0-r3
+  pid_t pid;                 // PID of new process, or -1 if it was not created
+} spawn_t;
+
 typedef enum
 {
   STATUS_INVALID,
 
   STATUS_CREATED,
   STATUS_TERMINATED,
+  STATUS_ZOMBIE,
 
   STATUS_READY,
   STATUS_EXECUTING,
@@ -63,26 +114,33 @@ typedef enum
 
 typedef struct
 {
-  uint32_t cpsr, pc, gpr[13], sp, lr;
+  uint32_t gpr[13], sp, lr, pc, cpsr;
 } ctx_t;
 
-typedef struct
-{
-  pid_t pid;       // Process IDentifier (PID)
-  status_t status; // current status
-  uint32_t tos;    // address of Top of Stack (ToS)
-  ctx_t ctx;       // execution context
-  int age;         //age of process
-  int priority;    //priority of process
-  int niceness;    //niceness of process
-} pcb_t;
+/* Processes execute in USR mode, whereas kernel threads execute in SYS
+ * mode: both use the USR mode register bank, so the low-level handlers
+ * preserve and restore either in the same way.
+ */
+
+#define CPSR_MODE       0x1F
+#define CPSR_MODE_USR   0x10
+#define CPSR_MODE_SYS   0x1F
+
+#define CPSR_USR        0x10 // USR mode, IRQ and FIQ interrupts enabled
+#define CPSR_KTHREAD    0x1F // SYS mode, IRQ and FIQ interrupts enabled
 
 typedef struct
 {
-  char buffer[buffersize];
+  char *buffer; // allocated by page allocator
+  int size;
   int head;
   int tail;
   int length;
+  int refs; // number of file descriptors referring to pipe
+  int writers; // number of those referring to its write end
+  uint32_t pages[PIPE_PAGES]; // frames lent by writes, queued after the buffer
+  int first; // index of first queued frame
+  int count; // number of queued frames
 
 } pipe_t;
 
@@ -90,6 +148,94 @@ typedef struct
 {
   pipe_t *file;
   bool free;
+  bool writer; // refers to write end of pipe
 } fd_t;
 
+typedef struct
+{
+  fd_t fds[MAX_FDS];
+  uint32_t refs; // processes sharing the table, i.e., threads
+} fd_table_t;
+
+typedef struct
+{
+  uint32_t base; // address of segment
+  uint32_t len;  // length of segment in bytes
+} iovec_t;
+
+typedef struct pcb
+{
+  pid_t pid;       // Process IDentifier (PID)
+  status_t status; // current status
+  uint32_t tos;    // address of Top of Stack (ToS)
+  ctx_t ctx;       // execution context
+  int age;         //age of process
+  int priority;    //priority of process
+  int niceness;    //niceness of process
+  void *wchan;     //channel waited on, iff. status is STATUS_WAITING
+  uint32_t stack;  //address of stack block, iff. a kernel thread
+  uint32_t stack_size; //size of stack in bytes (i.e., the most it can grow to)
+  as_t *as;        //address space, or NULL for a kernel thread
+  int exit_status; //exit status, iff. status is STATUS_ZOMBIE
+  fd_table_t *files; //file descriptor table, or NULL once exited
+  pid_t tgid;      //thread group, i.e., PID of the first process in it
+  uint32_t tls;    //thread pointer, i.e., TPIDRURO
+  ring_t *ring;    //submission/completion ring, or NULL if none is set up
+  uint32_t faults[VM_FAULT_TYPES]; //page faults resolved, by VM_FAULT_* type
+
+  struct pcb *parent;     // parent process, or NULL if none
+
+  uint32_t slot;          // index of PCB in process table
+  uint32_t generation;    // number of times slot has been allocated
+  struct pcb *hash_next;  // next PCB in same PID hash bucket
+  struct pcb *next;       // next PCB in live list
+  struct pcb *prev;       // previous PCB in live list
+} pcb_t;
+
+extern pcb_t *proc_list;
+extern uint32_t proc_count;
+
+// allocate a PCB with a fresh PID, or return NULL if none is available
+extern pcb_t *proc_alloc();
+// return pcb to free list
+extern void proc_free(pcb_t *pcb);
+// make pcb share the file descriptor table of parent, rather than its own
+extern void fd_table_share(pcb_t *pcb, pcb_t *parent);
+// drop the reference pcb holds to its file descriptor table
+extern void fd_table_put(pcb_t *pcb);
+// write up to n bytes from x to fd of pcb, without blocking; return bytes written, or -1 on error
+extern int fd_write(pcb_t *pcb, int fd, char *x, int n);
+// read up to n bytes into x from fd of pcb, without blocking; return bytes read, or -1 on error
+extern int fd_read(pcb_t *pcb, int fd, char *x, int n);
+// write n segments from iov to fd of pcb, without blocking; return bytes written, or -1 on error
+extern int fd_writev(pcb_t *pcb, int fd, iovec_t *iov, int n);
+// read into n segments from iov from fd of pcb, without blocking; return bytes read, or -1 on error
+extern int fd_readv(pcb_t *pcb, int fd, iovec_t *iov, int n);
+// return bytes ready to read from fd of pcb, or -1 on error
+extern int fd_poll(pcb_t *pcb, int fd);
+// return PCB for pid, or NULL if no such process exists
+extern pcb_t *proc_lookup(pid_t pid);
+
+extern pcb_t *executing;
+extern pcb_t *kworker;
+extern bool need_resched;
+extern int preempt_count; // non-zero iff. the executing thread may not be switched away from
+
+// write n bytes from x to UART0
+extern void print(char *x, int n);
+
+// block executing process on chan, restarting the current svc once woken
+extern void sleep_on(ctx_t *ctx, void *chan);
+// make every process blocked on chan ready
+extern void wakeup(void *chan);
+
+// create a process, child of parent, that starts executing at entry with args in r0-r3
+extern pcb_t *proc_spawn(pcb_t *parent, uint32_t entry, uint32_t *args, spawn_attr_t *attrs);
+// create a thread, child of parent, that starts executing at entry on stack with x in r0
+extern pcb_t *proc_clone(pcb_t *parent, uint32_t entry, uint32_t stack, uint32_t flags, uint32_t x);
+// create a kernel thread that starts executing at entry
+extern pcb_t *kthread_create(void (*entry)(), int priority);
+// yield control of processor from within a kernel thread
+extern void kthread_yield();
+
 #endif
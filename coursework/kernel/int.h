@@ -24,4 +24,9 @@ extern void int_enable_fiq();
 // disable FIQ interrupts
 extern void int_unable_fiq();
 
+// disable IRQ interrupts, returning the previous CPSR
+extern uint32_t int_save_irq();
+// restore IRQ interrupts to the state captured by CPSR x
+extern void int_restore_irq( uint32_t x );
+
 #endif
@@ -18,15 +18,18 @@
 int_data:            ldr   pc, int_addr_rst        @ reset                 vector -> SVC mode
                      b     .                       @ undefined instruction vector -> UND mode
                      ldr   pc, int_addr_svc        @ supervisor call       vector -> SVC mode
-                     b     .                       @ pre-fetch abort       vector -> ABT mode
-                     b     .                       @      data abort       vector -> ABT mode
+                     ldr   pc, int_addr_pabt       @ pre-fetch abort       vector -> ABT mode
+                     ldr   pc, int_addr_dabt       @      data abort       vector -> ABT mode
                      b     .                       @ reserved
                      ldr   pc, int_addr_irq        @ irq call              vector -> IRQ mode
-                     b     .                       @ FIQ                   vector -> FIQ mode
+                     ldr   pc, int_addr_fiq        @ FIQ                   vector -> FIQ mode
 
 int_addr_rst:        .word lolevel_handler_rst
 int_addr_svc:        .word lolevel_handler_svc
+int_addr_pabt:       .word lolevel_handler_pabt
+int_addr_dabt:       .word lolevel_handler_dabt
 int_addr_irq:        .word lolevel_handler_irq
+int_addr_fiq:        .word lolevel_handler_fiq
 	
 .global int_init
 	
@@ -50,6 +53,8 @@ l0:                  ldr   r3, [ r1 ], #4          @ load  word, inc. source
 .global int_unable_irq
 .global int_enable_fiq
 .global int_unable_fiq
+.global int_save_irq
+.global int_restore_irq
 	
 int_enable_irq:      mrs   r0,   cpsr              @ get USR mode CPSR
                      bic   r0, r0, #0x80           @  enable IRQ interrupts
@@ -74,3 +79,17 @@ int_unable_fiq:      mrs   r0,   cpsr              @ get USR mode CPSR
                      msr   cpsr_c, r0              @ set USR mode CPSR
         
                      mov   pc, lr                  @ return
+
+int_save_irq:        mrs   r0,   cpsr              @ get CPSR, which is returned
+                     orr   r1, r0, #0x80           @ disable IRQ interrupts
+                     msr   cpsr_c, r1              @ set CPSR
+
+                     mov   pc, lr                  @ return
+
+int_restore_irq:     mrs   r1,   cpsr              @ get CPSR
+                     bic   r1, r1, #0x80           @ copy IRQ interrupt mask ...
+                     and   r0, r0, #0x80           @ ... from previous CPSR
+                     orr   r1, r1, r0
+                     msr   cpsr_c, r1              @ set CPSR
+
+                     mov   pc, lr                  @ return
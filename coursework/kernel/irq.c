@@ -0,0 +1,108 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+irq_t irqs[IRQ_MAX];
+
+/* The priority and target registers are byte-accessible, with one byte per
+ * interrupt identifier, whereas the set- and clear-enable registers have
+ * one bit per identifier.
+ */
+
+volatile uint8_t *irq_priority_reg(uint32_t id)
+{
+  return (volatile uint8_t *)(GICD0->IPRIORITYR) + id;
+}
+
+volatile uint8_t *irq_target_reg(uint32_t id)
+{
+  return (volatile uint8_t *)(GICD0->ITARGETSR) + id;
+}
+
+void irq_init()
+{
+  GICD0->CTLR = 0x00000000; // disable GIC distributor
+  GICC0->CTLR = 0x00000000; // disable GIC interface
+
+  for (uint32_t id = 0; id < IRQ_MAX; id++)
+  {
+    irqs[id].handler = NULL;
+    irqs[id].priority = IRQ_PRIORITY_LOWEST;
+    irqs[id].affinity = IRQ_AFFINITY_CPU0;
+    irqs[id].count = 0;
+
+    *irq_priority_reg(id) = IRQ_PRIORITY_LOWEST;
+  }
+
+  GICD0->ICENABLER0 = 0xFFFFFFFF; // disable all interrupts
+  GICD0->ICENABLER1 = 0xFFFFFFFF;
+  GICD0->ICENABLER2 = 0xFFFFFFFF;
+
+  GICC0->PMR = IRQ_PRIORITY_MASK; // unmask all registered priorities
+  GICC0->BPR = 0x00000003;        // preempt on priority bits [7:4]
+  GICC0->CTLR = 0x00000001;       // enable GIC interface
+  GICD0->CTLR = 0x00000001;       // enable GIC distributor
+}
+
+int irq_register(uint32_t id, irq_handler_t handler, uint8_t priority, uint8_t affinity)
+{
+  if ((id >= IRQ_MAX) || (handler == NULL))
+  {
+    return -1;
+  }
+
+  irqs[id].handler = handler;
+  irqs[id].priority = priority & IRQ_PRIORITY_MASK;
+  irqs[id].affinity = affinity;
+
+  *irq_priority_reg(id) = irqs[id].priority;
+  *irq_target_reg(id) = affinity;
+  (&GICD0->ISENABLER0)[id / 32] = 1 << (id % 32);
+
+  return 0;
+}
+
+void irq_unregister(uint32_t id)
+{
+  if (id >= IRQ_MAX)
+  {
+    return;
+  }
+
+  (&GICD0->ICENABLER0)[id / 32] = 1 << (id % 32);
+  irqs[id].handler = NULL;
+}
+
+void irq_dispatch()
+{
+  // Step 2: read  the interrupt identifier so we know the source.
+
+  uint32_t iar = GICC0->IAR;
+  uint32_t id = iar & 0x3FF;
+
+  if (id == IRQ_SPURIOUS)
+  {
+    return;
+  }
+
+  // Step 4: handle the interrupt, with IRQ interrupts enabled so a higher
+  //         priority source can preempt this handler.
+
+  if ((id < IRQ_MAX) && (irqs[id].handler != NULL))
+  {
+    irqs[id].count++;
+
+    int_enable_irq();
+    irqs[id].handler(id);
+    int_unable_irq();
+  }
+
+  // Step 5: write the interrupt identifier to signal we're done.
+
+  GICC0->EOIR = iar;
+}
@@ -0,0 +1,63 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __IRQ_H
+#define __IRQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "GIC.h"
+
+/* A generic interface to the GIC: each interrupt identifier maps to a
+ * handler, a priority and an affinity (i.e., a target CPU mask), which
+ * irq_register programs into the distributor.  Handlers execute in SVC
+ * mode with IRQ interrupts enabled, so a source with a higher priority
+ * (i.e., numerically lower) preempts one with a lower priority; sources
+ * with the same or lower priority wait until the current one finishes,
+ * since the GIC only signals interrupts above the running priority.
+ *
+ * The GIC implements the top 4 bits of each priority, so priorities are
+ * multiples of 0x10; PMR masks anything at or below IRQ_PRIORITY_MASK.
+ */
+
+#define IRQ_MAX              ( 96 )
+#define IRQ_SPURIOUS         ( 1023 )
+
+#define IRQ_PRIORITY_HIGHEST ( 0x00 )
+#define IRQ_PRIORITY_UART    ( 0x40 )
+#define IRQ_PRIORITY_DISK    ( 0x60 )
+#define IRQ_PRIORITY_TIMER   ( 0xA0 )
+#define IRQ_PRIORITY_LOWEST  ( 0xE0 )
+#define IRQ_PRIORITY_MASK    ( 0xF0 )
+
+#define IRQ_AFFINITY_CPU0    ( 0x01 )
+
+typedef void (*irq_handler_t)(uint32_t id);
+
+typedef struct
+{
+  irq_handler_t handler; // handler, or NULL if unregistered
+  uint8_t priority;      // priority, lower is more urgent
+  uint8_t affinity;      // CPU target mask
+  uint32_t count;        // number of times handled
+} irq_t;
+
+extern irq_t irqs[IRQ_MAX];
+
+// initialise GIC distributor and CPU interface, with every source disabled
+extern void irq_init();
+// register handler for source id with priority and affinity, then enable it
+extern int irq_register(uint32_t id, irq_handler_t handler, uint8_t priority, uint8_t affinity);
+// disable source id and remove its handler
+extern void irq_unregister(uint32_t id);
+
+// acknowledge, handle and complete the highest priority pending interrupt
+extern void irq_dispatch();
+
+#endif
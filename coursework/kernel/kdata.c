@@ -0,0 +1,52 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+// a whole page, so nothing else the kernel keeps is visible alongside it
+uint8_t kdata_page[VM_PAGE_SIZE] __attribute__((aligned(VM_PAGE_SIZE)));
+uint32_t kdata_l2[VM_L2_ENTRIES] __attribute__((aligned(1024)));
+
+kdata_t *kdata = (kdata_t *)(kdata_page);
+
+void kdata_map(uint32_t *pt)
+{
+  memset(kdata_page, 0, sizeof(kdata_page));
+  memset(kdata_l2, 0, sizeof(kdata_l2));
+
+  kdata_l2[(KDATA_BASE >> VM_PAGE_SHIFT) % VM_L2_ENTRIES] = (uint32_t)(kdata_page) | (PAGE_USER_RO & ~PTE_L2_NG);
+  pt[KDATA_BASE >> VM_SECTION_SHIFT] = (uint32_t)(kdata_l2) | PTE_L1_COARSE;
+}
+
+void kdata_begin()
+{
+  kdata->seq++;
+  asm volatile("" ::: "memory"); // i.e., no store below moves above
+}
+
+void kdata_end()
+{
+  asm volatile("" ::: "memory"); // i.e., no store above moves below
+  kdata->seq++;
+}
+
+void kdata_clock()
+{
+  uint32_t x = SYSCONF->COUNTER_24MHZ;
+
+  kdata_begin();
+
+  if (x < kdata->last)
+  {
+    kdata->wraps++;
+  }
+
+  kdata->last = x;
+  kdata->ticks++;
+
+  kdata_end();
+}
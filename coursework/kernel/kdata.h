@@ -0,0 +1,63 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __KDATA_H
+#define __KDATA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The kernel publishes a little data in kdata, a page that every process
+ * can read (but not write) at KDATA_BASE, so a process can find out, e.g.,
+ * the time or its own PID without a system call.  The page is mapped by
+ * a global entry in the kernel page table (see vm_init), and therefore by
+ * every address space, whatever it maps in USER_BASE...USER_LIMIT: exec
+ * and fork never touch it.  It is only read-only via KDATA_BASE, though:
+ * the frame itself lies in the kernel image, which (like the rest of RAM)
+ * is identity mapped read/write at PL0 (see vm.h), so a process can still
+ * write to it, as to any kernel data, via its physical address.
+ *
+ * There is only one processor, so the pid field is simply rewritten by
+ * each dispatch: whichever process reads it is the executing one.  A
+ * process can be preempted part way through reading several fields,
+ * though, so each update is wrapped in kdata_begin and kdata_end, which
+ * increment seq (so it is odd during an update), and a reader retries
+ * until it sees the same even seq before and after (i.e., a seqlock).
+ *
+ * The clock is a 64-bit count of 24MHz ticks, i.e., COUNTER_24MHZ (which
+ * wraps every ~179s) plus wraps << 32: each timer tick samples the counter
+ * and counts a wrap whenever it went backward, so a reader that samples
+ * it again counts one more wrap iff. its sample is below last.
+ */
+
+#define KDATA_BASE ( 0x3FF00000 ) // i.e., the section just below USER_BASE
+
+typedef struct
+{
+  volatile uint32_t seq; // update count, times 2 (plus 1 during an update)
+  uint32_t wraps;        // times COUNTER_24MHZ had wrapped, as of last
+  uint32_t last;         // COUNTER_24MHZ when last sampled
+  uint32_t ticks;        // timer ticks since boot
+  int pid;               // PID of executing process
+  uint32_t switches;     // context switches since boot
+  uint32_t runnable;     // processes ready or executing, as of last schedule
+  uint32_t procs;        // live processes (including zombies and kernel threads)
+} kdata_t;
+
+extern kdata_t *kdata;
+
+// map kdata at KDATA_BASE in page table pt, read-only at PL0 and global
+extern void kdata_map(uint32_t *pt);
+// start updating kdata
+extern void kdata_begin();
+// finish updating kdata
+extern void kdata_end();
+// count a timer tick, sampling COUNTER_24MHZ (and counting a wrap iff. it went backward)
+extern void kdata_clock();
+
+#endif
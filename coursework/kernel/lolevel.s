@@ -14,7 +14,23 @@
 .global lolevel_handler_rst
 .global lolevel_handler_irq
 .global lolevel_handler_svc
+.global lolevel_handler_fiq
+.global lolevel_handler_pabt
+.global lolevel_handler_dabt
 
+.global lolevel_init_fiq
+
+
+/* All five handlers build the same frame on the SVC mode stack, which
+ * matches ctx_t: the USR (or SYS) mode registers r0-r12, sp and lr, then
+ * the preserved PC and CPSR as written by srsdb and consumed by rfeia.
+ * The IRQ handler switches into SVC mode straight away, so IRQ mode owns
+ * no state beyond the first three instructions; this means the C layer
+ * can re-enable interrupts (e.g., to run deferred work) without a nested
+ * IRQ clobbering lr_irq or spsr_irq.  SVC mode lr is preserved around the
+ * call into C since a nested IRQ may interrupt SVC mode execution, which
+ * also keeps the stack 8-byte aligned per AAPCS.
+ */
 
 lolevel_handler_rst: bl    int_init                @ initialise interrupt vector table
                      msr   cpsr, #0xD2             @ enter IRQ mode with IRQ and FIQ interrupts disabled
@@ -22,44 +38,138 @@ lolevel_handler_rst: bl    int_init                @ initialise interrupt vector
                      msr   cpsr, #0xD3             @ enter SVC mode with IRQ and FIQ interrupts disabled
                      ldr   sp, =tos_svc            @ initialise SVC mode stack
 
+                     sub   sp, sp, #68             @ allocate USR mode execution context
                      mov   r0, sp                  @ set    high-level C function arg. = SP
                      bl    hilevel_handler_rst     @ invoke high-level C function
 
-                     ldmia sp!, { r0, lr }         @ load     USR mode PC and CPSR
-                     msr   spsr, r0                @ move     USR mode        CPSR
                      ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
                      add   sp, sp, #60             @ update   SVC mode SP
-                     movs  pc, lr                  @ return from interrupt
+                     rfeia sp!                     @ return from interrupt, restoring USR PC and CPSR
                      b     .                       @ halt
 
 lolevel_handler_irq: sub   lr, lr, #4              @ correct return address
-                     sub   sp, sp, #60             @ update   IRQ mode stack
+                     srsdb sp!, #0x13              @ preserve USR PC and CPSR on SVC mode stack
+                     cps   #0x13                   @ enter    SVC mode with IRQ interrupts disabled
+                     sub   sp, sp, #60             @ update   SVC mode stack
                      stmia sp, { r0-r12, sp, lr }^ @ preserve USR registers
-                     mrs   r0, spsr                @ move     USR        CPSR
-                     stmdb sp!, { r0, lr }         @ store    USR PC and CPSR
 
                      mov   r0, sp                  @ set    high-level C function arg. = SP
+                     push  { lr }                  @ preserve SVC mode LR
                      bl    hilevel_handler_irq     @ invoke high-level C function
+                     pop   { lr }                  @ restore  SVC mode LR
 
-                     ldmia sp!, { r0, lr }         @ load     USR mode PC and CPSR
-                     msr   spsr, r0                @ move     USR mode        CPSR
                      ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
-                     add   sp, sp, #60             @ update   IRQ mode SP
-                     movs  pc, lr                  @ return from interrupt
+                     add   sp, sp, #60             @ update   SVC mode SP
+                     rfeia sp!                     @ return from interrupt, restoring USR PC and CPSR
 
-lolevel_handler_svc: sub   lr, lr, #0              @ correct return address
+lolevel_handler_svc: srsdb sp!, #0x13              @ preserve USR PC and CPSR on SVC mode stack
                      sub   sp, sp, #60             @ update   SVC mode stack
                      stmia sp, { r0-r12, sp, lr }^ @ preserve USR registers
-                     mrs   r0, spsr                @ move     USR        CPSR
-                     stmdb sp!, { r0, lr }         @ store    USR PC and CPSR
 
                      mov   r0, sp                  @ set    high-level C function arg. = SP
                      ldr   r1, [ lr, #-4 ]         @ load   svc instruction
                      bic   r1, r1, #0xFF000000     @ set    high-level C function arg. = svc immediate
+                     push  { lr }                  @ preserve SVC mode LR
                      bl    hilevel_handler_svc     @ invoke high-level C function
+                     pop   { lr }                  @ restore  SVC mode LR
 
-                     ldmia sp!, { r0, lr }         @ load     USR mode PC and CPSR
-                     msr   spsr, r0                @ move     USR mode        CPSR
                      ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
                      add   sp, sp, #60             @ update   SVC mode SP
-                     movs  pc, lr                  @ return from interrupt
\ No newline at end of file
+                     rfeia sp!                     @ return from interrupt, restoring USR PC and CPSR
+
+/* The abort handlers use the same frame, but may be taken from SVC mode
+ * as well as USR mode, i.e., when the kernel touches user memory (e.g., a
+ * copy-on-write or not yet committed page): r0-r12 are not banked, and
+ * the SVC mode SP and LR are preserved as for a nested IRQ, so either
+ * case returns to the faulting instruction intact.
+ */
+
+lolevel_handler_pabt:sub   lr, lr, #4              @ correct return address (i.e., retry fetch)
+                     srsdb sp!, #0x13              @ preserve USR PC and CPSR on SVC mode stack
+                     cps   #0x13                   @ enter    SVC mode with IRQ interrupts disabled
+                     sub   sp, sp, #60             @ update   SVC mode stack
+                     stmia sp, { r0-r12, sp, lr }^ @ preserve USR registers
+
+                     mov   r0, sp                  @ set    high-level C function arg. = SP
+                     push  { lr }                  @ preserve SVC mode LR
+                     bl    hilevel_handler_pabt    @ invoke high-level C function
+                     pop   { lr }                  @ restore  SVC mode LR
+
+                     ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
+                     add   sp, sp, #60             @ update   SVC mode SP
+                     rfeia sp!                     @ return from interrupt, restoring USR PC and CPSR
+
+
+lolevel_handler_dabt:sub   lr, lr, #8              @ correct return address (i.e., retry access)
+                     srsdb sp!, #0x13              @ preserve USR PC and CPSR on SVC mode stack
+                     cps   #0x13                   @ enter    SVC mode with IRQ interrupts disabled
+                     sub   sp, sp, #60             @ update   SVC mode stack
+                     stmia sp, { r0-r12, sp, lr }^ @ preserve USR registers
+
+                     mov   r0, sp                  @ set    high-level C function arg. = SP
+                     push  { lr }                  @ preserve SVC mode LR
+                     bl    hilevel_handler_dabt    @ invoke high-level C function
+                     pop   { lr }                  @ restore  SVC mode LR
+
+                     ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
+                     add   sp, sp, #60             @ update   SVC mode SP
+                     rfeia sp!                     @ return from interrupt, restoring USR PC and CPSR
+
+/* The FIQ handler services a single PL011 using only the banked FIQ mode
+ * registers (see fiq.h), so nothing is preserved: it stamps the time of
+ * entry, drains the receive FIFO into fiq_ring, completes the interrupt,
+ * then raises an SGI so the remaining work is done by the IRQ path.  Note
+ * that 0x100 (resp. 0xFF) and 0x24 match FIQ_RING_SIZE (resp. its mask)
+ * and the offset of fiq_ring.data.
+ */
+
+lolevel_handler_fiq: sub   lr, lr, #4              @ correct return address
+                     ldr   r10, [ r9, #0x18 ]      @ read   clock ...
+                     ldr   r10, [ r10 ]
+                     str   r10, [ r9, #0x10 ]      @ ... and store as entry stamp
+                     ldr   r10, [ r12, #0x0C ]     @ acknowledge interrupt, i.e., read GICC1 IAR ...
+                     str   r10, [ r9, #0x14 ]      @ ... and keep it for EOIR
+                     ldr   r10, [ r9, #0x0C ]      @ increment FIQ count
+                     add   r10, r10, #1
+                     str   r10, [ r9, #0x0C ]
+
+fiq_l0:              ldr   r10, [ r8, #0x18 ]      @ read   UART FR
+                     tst   r10, #0x10              @ finish if receive FIFO empty
+                     bne   fiq_l2
+
+                     ldr   r11, [ r9, #0x00 ]      @ compute occupancy = head - tail
+                     ldr   r10, [ r9, #0x04 ]
+                     sub   r10, r11, r10
+                     cmp   r10, #0x100             @ drop byte if ring full
+                     bhs   fiq_l1
+
+                     and   r11, r11, #0xFF         @ compute offset of data[ head % size ]
+                     add   r11, r11, #0x24
+                     ldr   r10, [ r8, #0x00 ]      @ read   UART DR
+                     strb  r10, [ r9, r11 ]        @ store  byte
+                     ldr   r11, [ r9, #0x00 ]      @ increment head
+                     add   r11, r11, #1
+                     str   r11, [ r9, #0x00 ]
+                     b     fiq_l0
+
+fiq_l1:              ldr   r10, [ r8, #0x00 ]      @ read   UART DR, and discard byte
+                     ldr   r10, [ r9, #0x08 ]      @ increment dropped count
+                     add   r10, r10, #1
+                     str   r10, [ r9, #0x08 ]
+                     b     fiq_l0
+
+fiq_l2:              ldr   r10, [ r9, #0x14 ]      @ complete interrupt, i.e., write IAR to GICC1 EOIR
+                     str   r10, [ r12, #0x10 ]
+                     ldr   r10, [ r9, #0x20 ]      @ raise  bottom half, i.e., write GICD0 SGIR
+                     ldr   r11, [ r9, #0x1C ]
+                     str   r10, [ r11 ]
+                     movs  pc, lr                  @ return from interrupt
+
+lolevel_init_fiq:    mrs   r3, cpsr                @ preserve current CPSR
+                     msr   cpsr_c, #0xD1           @ enter FIQ mode with IRQ and FIQ interrupts disabled
+                     mov   r8,  r0                 @ r8  = UART
+                     mov   r9,  r1                 @ r9  = ring
+                     mov   r12, r2                 @ r12 = GIC CPU interface
+                     msr   cpsr_c, r3              @ restore   current CPSR
+
+                     mov   pc, lr                  @ return
@@ -0,0 +1,185 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* The kernel and every user program are linked into one image, so these
+ * replace the newlib memcpy, memset and memcmp for both, iff. the build
+ * sets MEMOPS (see PROJECT_MEMOPS in the Makefile): otherwise nothing is
+ * assembled, and newlib supplies them as before.
+ *
+ * Each one is tuned for the Cortex-A8 using only core registers, since
+ * everything is built for soft-float: NEON is never enabled (via CPACR and
+ * FPEXC), and the kernel preserves no VFP state across a context switch,
+ * so using it would mean doing both for a few cycles per 64 bytes.  Bulk
+ * data moves 64 bytes per iteration via a pair of 8-register ldm/stm, so
+ * one cache line, with the line 3 ahead prefetched via pld; the remainder
+ * moves 16 bytes, then a word, then a byte at a time, so for instance a
+ * ctx_t (i.e., 68 bytes, word-aligned) is one iteration plus one word.
+ * When source and destination differ in alignment, memcpy aligns the
+ * destination, then merges pairs of aligned source words via shifts:
+ * every access is aligned, so all of them are safe before the MMU is
+ * enabled (when memory is strongly-ordered), and on device memory.
+ */
+
+.if MEMOPS
+
+.global memcpy
+.global memset
+.global memcmp
+
+@ memcpy( r0 = x, r1 = y, r2 = n ): copy n bytes from y to x, returning x
+
+memcpy:              mov   r12, r0                 @ preserve x, as result
+                     cmp   r2, #8
+                     blo   .Lcpy_bytes             @ if n < 8, copy bytes
+
+.Lcpy_align:         tst   r0, #3
+                     beq   .Lcpy_aligned
+                     ldrb  r3, [ r1 ], #1          @ copy byte until x is word-aligned
+                     strb  r3, [ r0 ], #1
+                     sub   r2, r2, #1
+                     b     .Lcpy_align
+
+.Lcpy_aligned:       tst   r1, #3
+                     bne   .Lcpy_shift             @ if y is not word-aligned too, merge words
+
+                     push  { r4-r11 }
+.Lcpy_64:            subs  r2, r2, #64
+                     blo   .Lcpy_16
+                     pld   [ r1, #192 ]            @ prefetch 3 lines ahead
+                     ldmia r1!, { r4-r11 }         @ copy 64 bytes, i.e., 1 line
+                     stmia r0!, { r4-r11 }
+                     ldmia r1!, { r4-r11 }
+                     stmia r0!, { r4-r11 }
+                     b     .Lcpy_64
+.Lcpy_16:            add   r2, r2, #64
+.Lcpy_16_loop:       subs  r2, r2, #16
+                     blo   .Lcpy_4
+                     ldmia r1!, { r4-r7 }          @ copy 16 bytes
+                     stmia r0!, { r4-r7 }
+                     b     .Lcpy_16_loop
+.Lcpy_4:             add   r2, r2, #16
+                     pop   { r4-r11 }
+.Lcpy_4_loop:        subs  r2, r2, #4
+                     blo   .Lcpy_tail
+                     ldr   r3, [ r1 ], #4          @ copy word
+                     str   r3, [ r0 ], #4
+                     b     .Lcpy_4_loop
+.Lcpy_tail:          add   r2, r2, #4
+                     b     .Lcpy_bytes
+
+.Lcpy_shift:         push  { r4-r7 }
+                     and   r6, r1, #3
+                     bic   r1, r1, #3
+                     mov   r6, r6, lsl #3          @ r6 = 8 * ( y mod 4 ), i.e., bits of first word to skip
+                     rsb   r7, r6, #32             @ r7 = 32 - r6
+                     ldr   r4, [ r1 ], #4          @ load first (partial) word
+.Lcpy_shift_loop:    subs  r2, r2, #4
+                     blo   .Lcpy_shift_done
+                     ldr   r5, [ r1 ], #4          @ load next word
+                     mov   r3, r4, lsr r6          @ merge last and next words, then store
+                     orr   r3, r3, r5, lsl r7
+                     str   r3, [ r0 ], #4
+                     mov   r4, r5
+                     b     .Lcpy_shift_loop
+.Lcpy_shift_done:    add   r2, r2, #4
+                     sub   r1, r1, #4              @ point y at first byte not yet copied
+                     add   r1, r1, r6, lsr #3
+                     pop   { r4-r7 }
+
+.Lcpy_bytes:         cmp   r2, #0
+                     beq   .Lcpy_done
+.Lcpy_bytes_loop:    ldrb  r3, [ r1 ], #1          @ copy byte
+                     strb  r3, [ r0 ], #1
+                     subs  r2, r2, #1
+                     bne   .Lcpy_bytes_loop
+.Lcpy_done:          mov   r0, r12                 @ return x
+                     bx    lr
+
+@ memset( r0 = x, r1 = c, r2 = n ): set n bytes at x to c, returning x
+
+memset:              mov   r12, r0                 @ preserve x, as result
+                     and   r1, r1, #0xFF
+                     cmp   r2, #8
+                     blo   .Lset_bytes             @ if n < 8, set bytes
+
+.Lset_align:         tst   r0, #3
+                     beq   .Lset_aligned
+                     strb  r1, [ r0 ], #1          @ set byte until x is word-aligned
+                     sub   r2, r2, #1
+                     b     .Lset_align
+
+.Lset_aligned:       orr   r1, r1, r1, lsl #8      @ replicate c into each byte of word
+                     orr   r1, r1, r1, lsl #16
+                     push  { r4-r9 }
+                     mov   r3, r1
+                     mov   r4, r1
+                     mov   r5, r1
+                     mov   r6, r1
+                     mov   r7, r1
+                     mov   r8, r1
+                     mov   r9, r1
+.Lset_64:            subs  r2, r2, #64
+                     blo   .Lset_4
+                     stmia r0!, { r1, r3-r9 }      @ set 64 bytes, i.e., 1 line
+                     stmia r0!, { r1, r3-r9 }
+                     b     .Lset_64
+.Lset_4:             add   r2, r2, #64
+                     pop   { r4-r9 }
+.Lset_4_loop:        subs  r2, r2, #4
+                     blo   .Lset_tail
+                     str   r1, [ r0 ], #4          @ set word
+                     b     .Lset_4_loop
+.Lset_tail:          add   r2, r2, #4
+
+.Lset_bytes:         cmp   r2, #0
+                     beq   .Lset_done
+.Lset_bytes_loop:    strb  r1, [ r0 ], #1          @ set byte
+                     subs  r2, r2, #1
+                     bne   .Lset_bytes_loop
+.Lset_done:          mov   r0, r12                 @ return x
+                     bx    lr
+
+@ memcmp( r0 = x, r1 = y, r2 = n ): compare n bytes at x and y, returning difference of first that differ (or 0)
+
+memcmp:              eor   r3, r0, r1
+                     tst   r3, #3
+                     bne   .Lcmp_bytes             @ if x and y differ in alignment, compare bytes
+                     cmp   r2, #8
+                     blo   .Lcmp_bytes             @ if n < 8,                       compare bytes
+
+.Lcmp_align:         tst   r0, #3
+                     beq   .Lcmp_4
+                     ldrb  r3, [ r0 ], #1          @ compare byte until x (and so y) is word-aligned
+                     ldrb  r12, [ r1 ], #1
+                     subs  r3, r3, r12
+                     bne   .Lcmp_done
+                     sub   r2, r2, #1
+                     b     .Lcmp_align
+
+.Lcmp_4:             subs  r2, r2, #4
+                     blo   .Lcmp_tail
+                     ldr   r3, [ r0 ], #4          @ compare word
+                     ldr   r12, [ r1 ], #4
+                     cmp   r3, r12
+                     beq   .Lcmp_4
+                     sub   r0, r0, #4              @ words differ, so find which byte via bytes
+                     sub   r1, r1, #4
+.Lcmp_tail:          add   r2, r2, #4
+
+.Lcmp_bytes:         cmp   r2, #0
+                     beq   .Lcmp_same
+.Lcmp_bytes_loop:    ldrb  r3, [ r0 ], #1          @ compare byte
+                     ldrb  r12, [ r1 ], #1
+                     subs  r3, r3, r12
+                     bne   .Lcmp_done
+                     subs  r2, r2, #1
+                     bne   .Lcmp_bytes_loop
+.Lcmp_same:          mov   r3, #0
+.Lcmp_done:          mov   r0, r3                  @ return difference
+                     bx    lr
+
+.endif
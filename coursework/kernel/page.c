@@ -0,0 +1,197 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+extern uint32_t image_end;
+
+page_t *page_map = NULL;
+page_t *page_free_list[PAGE_ORDERS];
+uint32_t page_free_count[PAGE_ORDERS];
+
+uint32_t page_base = 0;
+uint32_t page_total = 0;
+
+page_t *page_of(uint32_t x)
+{
+  return &page_map[(x - page_base) >> PAGE_SHIFT];
+}
+
+uint32_t page_addr(page_t *p)
+{
+  return page_base + ((p - page_map) << PAGE_SHIFT);
+}
+
+void page_push(page_t *p, int k)
+{
+  p->order = k;
+  p->flags = PAGE_FREE;
+  p->prev = NULL;
+  p->next = page_free_list[k];
+  if (p->next != NULL)
+  {
+    p->next->prev = p;
+  }
+  page_free_list[k] = p;
+  page_free_count[k]++;
+}
+
+void page_pop(page_t *p)
+{
+  int k = p->order;
+
+  if (p->prev != NULL)
+  {
+    p->prev->next = p->next;
+  }
+  else
+  {
+    page_free_list[k] = p->next;
+  }
+  if (p->next != NULL)
+  {
+    p->next->prev = p->prev;
+  }
+
+  p->flags = 0;
+  page_free_count[k]--;
+}
+
+void page_init(uint32_t x, uint32_t n)
+{
+  page_base = x;
+  page_total = n >> PAGE_SHIFT;
+
+  // the array of page_t goes immediately after the (page aligned) image
+  uint32_t end = ((uint32_t)(&image_end) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+  page_map = (page_t *)(end);
+  uint32_t reserved = (end + page_total * sizeof(page_t) - x + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+  for (int k = 0; k < PAGE_ORDERS; k++)
+  {
+    page_free_list[k] = NULL;
+    page_free_count[k] = 0;
+  }
+
+  for (uint32_t i = 0; i < page_total; i++)
+  {
+    page_map[i].next = NULL;
+    page_map[i].prev = NULL;
+    page_map[i].refs = 0;
+    page_map[i].order = 0;
+    page_map[i].flags = (i < reserved) ? PAGE_RESERVED : 0;
+  }
+
+  // free what remains as the largest aligned blocks that fit
+  for (uint32_t i = reserved; i < page_total;)
+  {
+    int k = PAGE_ORDERS - 1;
+
+    while ((i & ((1 << k) - 1)) || ((i + (1 << k)) > page_total))
+    {
+      k--;
+    }
+
+    page_push(&page_map[i], k);
+    i += 1 << k;
+  }
+}
+
+int page_order(size_t n)
+{
+  int k = 0;
+
+  while ((PAGE_SIZE << k) < n)
+  {
+    k++;
+  }
+
+  return k;
+}
+
+uint32_t page_alloc(int k)
+{
+  int j = k;
+
+  while ((j < PAGE_ORDERS) && (page_free_list[j] == NULL))
+  {
+    j++;
+  }
+  if (j == PAGE_ORDERS)
+  {
+    return 0;
+  }
+
+  page_t *p = page_free_list[j];
+  page_pop(p);
+
+  // split, returning the upper half of each block to the free list
+  while (j > k)
+  {
+    j--;
+    page_push(p + (1 << j), j);
+  }
+
+  p->order = k;
+  p->refs = 1;
+
+  return page_addr(p);
+}
+
+void page_free(page_t *p)
+{
+  int k = p->order;
+  uint32_t i = p - page_map;
+
+  while (k < (PAGE_ORDERS - 1))
+  {
+    uint32_t j = i ^ (1 << k);
+    page_t *buddy = &page_map[j];
+
+    if ((j >= page_total) || !(buddy->flags & PAGE_FREE) || (buddy->order != k))
+    {
+      break;
+    }
+
+    page_pop(buddy);
+    i &= ~(1 << k);
+    k++;
+  }
+
+  page_push(&page_map[i], k);
+}
+
+bool page_managed(uint32_t x)
+{
+  return (x >= page_base) && (((x - page_base) >> PAGE_SHIFT) < page_total) && !(page_of(x)->flags & PAGE_RESERVED);
+}
+
+void page_get(uint32_t x)
+{
+  if (page_managed(x))
+  {
+    page_of(x)->refs++;
+  }
+}
+
+void page_put(uint32_t x)
+{
+  if (page_managed(x))
+  {
+    page_t *p = page_of(x);
+
+    if (--p->refs == 0)
+    {
+      page_free(p);
+    }
+  }
+}
+
+uint16_t page_refs(uint32_t x)
+{
+  return page_managed(x) ? page_of(x)->refs : 1;
+}
@@ -0,0 +1,64 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __PAGE_H
+#define __PAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Physical memory is managed by a buddy allocator: RAM is divided into
+ * 4KB frames, and free frames are kept in blocks of 2^k frames (for order
+ * k < PAGE_ORDERS), each aligned to its own size.  Allocating a block of
+ * order k splits the smallest free block of order >= k in half until it
+ * is the right size; freeing one merges it with its buddy (i.e., the
+ * other half of the block of order k + 1 it came from) for as long as the
+ * buddy is free too.  Each order has a doubly-linked free list, so every
+ * step takes constant time.
+ *
+ * There is one page_t per frame, placed in RAM just after the kernel
+ * image: every frame below the end of that array (i.e., the image,
+ * including the vector table and mode stacks, and the array itself) is
+ * reserved, so never allocated.  Allocated blocks are reference counted,
+ * so frames can be shared (e.g., copy-on-write between address spaces).
+ */
+
+#define PAGE_SIZE       ( 0x00001000 )
+#define PAGE_SHIFT      ( 12 )
+#define PAGE_ORDERS     ( 11 ) // i.e., blocks of up to 4MB
+
+#define PAGE_FREE       ( 0x01 ) // first frame of a free block
+#define PAGE_RESERVED   ( 0x02 ) // never allocated
+
+typedef struct page
+{
+  struct page *next; // next block in free list, iff. free
+  struct page *prev; // previous block in free list, iff. free
+  uint16_t refs;     // number of references, iff. first frame of an allocated block
+  uint8_t order;     // order of block, iff. first frame of a block
+  uint8_t flags;
+} page_t;
+
+extern uint32_t page_free_count[PAGE_ORDERS];
+extern uint32_t page_total;
+
+// initialise the allocator for n bytes of RAM starting at x
+extern void page_init(uint32_t x, uint32_t n);
+// return the smallest order st. a block holds n bytes
+extern int page_order(size_t n);
+// allocate a block of 2^k frames, with one reference, or return 0 if none is available
+extern uint32_t page_alloc(int k);
+// take or drop a reference to the block at x (which is freed once unused)
+extern void page_get(uint32_t x);
+extern void page_put(uint32_t x);
+// return the number of references to the block at x
+extern uint16_t page_refs(uint32_t x);
+// return true iff. x lies in a frame the allocator manages
+extern bool page_managed(uint32_t x);
+
+#endif
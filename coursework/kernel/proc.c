@@ -0,0 +1,160 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+/* PCBs, and the file descriptor table each one has, are allocated from
+ * slab caches, so allocation and deallocation take constant time and the
+ * process table grows on demand.  A table is reference counted, since
+ * threads (see proc_clone) may share one.  Each PCB keeps the index of its
+ * slot (assigned by the constructor, i.e., once per object), plus a
+ * generation count incremented each time the slot is reused.
+ *
+ * PIDs are allocated from a monotonically increasing counter, so a stale
+ * PID never names a newer process that happens to reuse the same slot;
+ * a hash table maps each live PID to its PCB.  Live PCBs are also kept in
+ * a doubly-linked list, which the scheduler iterates over.
+ */
+
+pcb_t *proc_list = NULL;
+pcb_t *proc_hash[PROC_HASH];
+
+uint32_t proc_slots = 0;
+uint32_t proc_count = 0;
+pid_t proc_next_pid = 0;
+
+void proc_ctor(void *x)
+{
+  pcb_t *pcb = x;
+
+  pcb->slot = proc_slots++;
+  pcb->generation = 0;
+  pcb->status = STATUS_INVALID;
+}
+
+slab_cache_t pcb_cache = SLAB_CACHE("pcb", pcb_t, proc_ctor);
+slab_cache_t fd_cache = SLAB_CACHE("fd", fd_table_t, NULL);
+
+pcb_t *proc_alloc()
+{
+  pcb_t *pcb = slab_alloc(&pcb_cache);
+
+  if (pcb == NULL)
+  {
+    return NULL;
+  }
+
+  fd_table_t *files = slab_alloc(&fd_cache);
+
+  if (files == NULL)
+  {
+    slab_free(&pcb_cache, pcb);
+    return NULL;
+  }
+
+  uint32_t slot = pcb->slot;
+  uint32_t generation = pcb->generation + 1;
+
+  memset(pcb, 0, sizeof(pcb_t)); // initialise PCB
+  pcb->slot = slot;
+  pcb->generation = generation;
+  pcb->pid = proc_next_pid++;
+  pcb->tgid = pcb->pid;
+  pcb->status = STATUS_CREATED;
+  pcb->files = files;
+  pcb->files->refs = 1;
+
+  for (int fd = 0; fd < MAX_FDS; fd++)
+  {
+    pcb->files->fds[fd].free = true;
+    pcb->files->fds[fd].file = NULL;
+    pcb->files->fds[fd].writer = false;
+  }
+
+  pcb_t **bucket = &proc_hash[pcb->pid % PROC_HASH];
+  pcb->hash_next = *bucket;
+  *bucket = pcb;
+
+  pcb->prev = NULL;
+  pcb->next = proc_list;
+  if (proc_list != NULL)
+  {
+    proc_list->prev = pcb;
+  }
+  proc_list = pcb;
+
+  proc_count++;
+
+  return pcb;
+}
+
+void proc_free(pcb_t *pcb)
+{
+  for (pcb_t **p = &proc_hash[pcb->pid % PROC_HASH]; *p != NULL; p = &(*p)->hash_next)
+  {
+    if (*p == pcb)
+    {
+      *p = pcb->hash_next;
+      break;
+    }
+  }
+
+  if (pcb->prev != NULL)
+  {
+    pcb->prev->next = pcb->next;
+  }
+  else
+  {
+    proc_list = pcb->next;
+  }
+  if (pcb->next != NULL)
+  {
+    pcb->next->prev = pcb->prev;
+  }
+
+  pcb->status = STATUS_INVALID;
+  fd_table_put(pcb);
+  slab_free(&pcb_cache, pcb);
+
+  proc_count--;
+}
+
+void fd_table_share(pcb_t *pcb, pcb_t *parent)
+{
+  fd_table_put(pcb);
+
+  parent->files->refs++;
+  pcb->files = parent->files;
+}
+
+void fd_table_put(pcb_t *pcb)
+{
+  if ((pcb->files != NULL) && (--pcb->files->refs == 0))
+  {
+    slab_free(&fd_cache, pcb->files);
+  }
+
+  pcb->files = NULL;
+}
+
+pcb_t *proc_lookup(pid_t pid)
+{
+  if (pid < 0)
+  {
+    return NULL;
+  }
+
+  for (pcb_t *p = proc_hash[pid % PROC_HASH]; p != NULL; p = p->hash_next)
+  {
+    if (p->pid == pid)
+    {
+      return p;
+    }
+  }
+
+  return NULL;
+}
@@ -0,0 +1,210 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+slab_cache_t ring_cache = SLAB_CACHE("ring", ring_t, NULL);
+
+uint32_t ring_setup(pcb_t *pcb, uint32_t flags)
+{
+  if ((pcb->ring != NULL) || (pcb->as == NULL))
+  {
+    return 0;
+  }
+
+  ring_t *ring = slab_alloc(&ring_cache);
+
+  if (ring == NULL)
+  {
+    return 0;
+  }
+
+  shm_t *shm = shm_create(0, PAGE_SIZE);
+  uint32_t pa = (shm != NULL) ? shm_frame(shm, 0) : 0;
+  uint32_t va = (pa != 0) ? vm_region_gap(pcb->as, USER_MMAP_BASE, USER_MMAP_LIMIT, PAGE_SIZE) : 0;
+
+  // the ring keeps the reference shm_create returns, and the region takes another
+  if ((va == 0) || !vm_region_map(pcb->as, va, va + PAGE_SIZE, shm, 0))
+  {
+    if (shm != NULL)
+    {
+      shm_put(shm);
+    }
+    slab_free(&ring_cache, ring);
+    return 0;
+  }
+
+  ring->page = (ring_page_t *)(pa);
+  ring->shm = shm;
+  ring->flags = flags;
+  ring->count = 0;
+
+  pcb->ring = ring;
+
+  return va;
+}
+
+void ring_free(pcb_t *pcb)
+{
+  if (pcb->ring != NULL)
+  {
+    shm_put(pcb->ring->shm);
+    slab_free(&ring_cache, pcb->ring);
+    pcb->ring = NULL;
+  }
+}
+
+// execute op, storing the result in res; return false iff. it cannot complete yet
+bool ring_exec(pcb_t *pcb, ring_op_t *op, int32_t *res)
+{
+  ring_sqe_t *sqe = &op->sqe;
+  int r;
+
+  switch (sqe->op)
+  {
+  case RING_NOP:
+    r = 0;
+    break;
+
+  case RING_READ:
+  case RING_WRITE:
+  {
+    uint32_t n = (sqe->len > RING_MAX_LEN) ? RING_MAX_LEN : sqe->len;
+
+    if (!vm_user(pcb->as, sqe->addr, n, sqe->op == RING_READ))
+    {
+      r = -1;
+      break;
+    }
+
+    if (sqe->op == RING_READ)
+    {
+      r = fd_read(pcb, sqe->fd, (char *)(sqe->addr), n);
+    }
+    else
+    {
+      r = fd_write(pcb, sqe->fd, (char *)(sqe->addr), n);
+    }
+
+    if ((r == 0) && (n > 0))
+    {
+      return false;
+    }
+    break;
+  }
+
+  case RING_POLL:
+    r = fd_poll(pcb, sqe->fd);
+
+    if (r == 0)
+    {
+      return false;
+    }
+    break;
+
+  case RING_SLEEP:
+    if ((int32_t)(SYSCONF->COUNTER_24MHZ - op->deadline) < 0)
+    {
+      return false;
+    }
+
+    r = 0;
+    break;
+
+  default:
+    r = -1;
+    break;
+  }
+
+  *res = r;
+
+  return true;
+}
+
+// return true iff. both operations use the same fd, so must complete in order
+bool ring_ordered(ring_op_t *x, ring_op_t *y)
+{
+  bool fds = (x->sqe.op != RING_NOP) && (x->sqe.op != RING_SLEEP) && (y->sqe.op != RING_NOP) && (y->sqe.op != RING_SLEEP);
+
+  return fds && (x->sqe.fd == y->sqe.fd);
+}
+
+// return true iff. one of the first n pending operations must complete before op
+bool ring_blocked(ring_t *ring, ring_op_t *op, int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+    if (ring_ordered(&ring->pending[i], op))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ring_post(ring_page_t *page, uint32_t user_data, int32_t res)
+{
+  ring_cqe_t *cqe = &page->cq[page->cq_tail % RING_CQ];
+
+  cqe->user_data = user_data;
+  cqe->res = res;
+
+  asm volatile("" ::: "memory"); // i.e., the entry is written before it is published
+  page->cq_tail++;
+}
+
+int ring_process(pcb_t *pcb, bool submit)
+{
+  ring_t *ring = pcb->ring;
+  ring_page_t *page = ring->page;
+  int32_t res;
+
+  // a completion is only attempted once there is room to post it
+  for (int i = 0; (i < ring->count) && ((page->cq_tail - page->cq_head) < RING_CQ);)
+  {
+    ring_op_t *op = &ring->pending[i];
+
+    if (ring_blocked(ring, op, i) || !ring_exec(pcb, op, &res))
+    {
+      i++;
+      continue;
+    }
+
+    ring_post(page, op->sqe.user_data, res);
+
+    ring->count--;
+    memmove(op, op + 1, (ring->count - i) * sizeof(ring_op_t));
+  }
+
+  int n = 0;
+  uint32_t tail = page->sq_tail;
+
+  asm volatile("" ::: "memory"); // i.e., entries are read after the tail that publishes them
+
+  while (submit && (page->sq_head != tail) && ((tail - page->sq_head) <= RING_SQ) && (ring->count < RING_PENDING) && ((page->cq_tail - page->cq_head) < RING_CQ))
+  {
+    ring_op_t op;
+
+    op.sqe = page->sq[page->sq_head % RING_SQ];
+    op.deadline = SYSCONF->COUNTER_24MHZ + (op.sqe.len * 24); // i.e., 24MHz ticks
+
+    page->sq_head++;
+    n++;
+
+    if (!ring_blocked(ring, &op, ring->count) && ring_exec(pcb, &op, &res))
+    {
+      ring_post(page, op.sqe.user_data, res);
+    }
+    else
+    {
+      ring->pending[ring->count++] = op;
+    }
+  }
+
+  return n;
+}
@@ -0,0 +1,107 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __RING_H
+#define __RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A process can batch system calls via a ring, i.e., one page shared with
+ * the kernel (an anonymous shared memory object, see shm.h) that holds a
+ * submission queue and a completion queue.  The process fills submission
+ * entries then advances sq_tail; the kernel consumes entries (advancing
+ * sq_head) and posts one completion per entry (advancing cq_tail), which
+ * the process reaps from memory (advancing cq_head).  Each index only
+ * ever increases, and is reduced modulo the queue size to use.
+ *
+ * Entries are consumed by ring_enter, i.e., one system call for any
+ * number of them, or, iff. the ring was set up with RING_SETUP_POLL, each
+ * time the kernel returns to the process (see return_to_thread), so no
+ * system call at all is needed.  Either way this happens once the process
+ * is current, never from within the scheduler, and each read or write
+ * moves at most RING_MAX_LEN bytes (so, like the system call, completes
+ * with a short count), which bounds how long the kernel spends on one.
+ * A buffer must lie in the address space of the process, per vm_user.
+ * An operation that cannot complete yet (e.g., a read from an empty pipe,
+ * or a sleep) is kept pending in the kernel, which retries it each time
+ * it returns to the process (or it calls ring_enter); later operations on
+ * the same fd wait behind it, so each fd sees them in order.  Operations
+ * on different fds, though, may complete out of order: user_data says
+ * which is which.
+ *
+ * Only the process that set up a ring (i.e., not a forked child, nor a
+ * thread, although both still map the page) submits to it, and exec or
+ * exit tears it down.
+ */
+
+#define RING_SQ      ( 64 )  // submission queue entries
+#define RING_CQ      ( 128 ) // completion queue entries
+#define RING_PENDING ( 16 )  // operations kept pending, at most
+#define RING_MAX_LEN ( 4096 ) // bytes moved per read or write, at most
+
+#define RING_SETUP_POLL  ( 0x01 ) // setup flag: consume entries on each return to the process
+#define RING_ENTER_YIELD ( 0x01 ) // enter flag: yield once entries are consumed
+
+#define RING_NOP     ( 0x00 ) // complete straight away, with result 0
+#define RING_READ    ( 0x01 ) // read up to len bytes from fd into addr
+#define RING_WRITE   ( 0x02 ) // write up to len bytes to fd from addr
+#define RING_POLL    ( 0x03 ) // wait for fd to be readable, with result bytes ready
+#define RING_SLEEP   ( 0x04 ) // wait for len microseconds
+
+typedef struct
+{
+  uint16_t op;        // RING_* operation
+  int16_t fd;         // file descriptor, iff. op uses one
+  uint32_t addr;      // buffer address, iff. op uses one
+  uint32_t len;       // buffer length (or time, for RING_SLEEP)
+  uint32_t user_data; // copied into completion, so the process can match them
+} ring_sqe_t;
+
+typedef struct
+{
+  uint32_t user_data; // as submitted
+  int32_t res;        // result, as per the corresponding system call
+} ring_cqe_t;
+
+typedef struct
+{
+  volatile uint32_t sq_head; // written by kernel
+  volatile uint32_t sq_tail; // written by process
+  volatile uint32_t cq_head; // written by process
+  volatile uint32_t cq_tail; // written by kernel
+  uint32_t reserved[12];     // i.e., the header is 64 bytes
+  ring_sqe_t sq[RING_SQ];
+  ring_cqe_t cq[RING_CQ];
+} ring_page_t;
+
+typedef struct
+{
+  ring_sqe_t sqe;    // as submitted
+  uint32_t deadline; // COUNTER_24MHZ value to wait for, iff. RING_SLEEP
+} ring_op_t;
+
+typedef struct ring
+{
+  ring_page_t *page;                // shared page, via the identity mapping
+  struct shm *shm;                  // object holding it, so it outlives any mapping
+  uint32_t flags;                   // RING_SETUP_* flags
+  ring_op_t pending[RING_PENDING];  // operations yet to complete, in order
+  int count;                        // number pending
+} ring_t;
+
+struct pcb;
+
+// set up a ring for pcb, and map it; return its address, or 0 on failure
+extern uint32_t ring_setup(struct pcb *pcb, uint32_t flags);
+// tear down the ring of pcb, iff. it has one
+extern void ring_free(struct pcb *pcb);
+// retry pending operations of pcb, then consume new entries iff. submit; return entries consumed
+extern int ring_process(struct pcb *pcb, bool submit);
+
+#endif
@@ -0,0 +1,270 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+slab_cache_t shm_cache = SLAB_CACHE("shm", shm_t, NULL);
+
+shm_t *shm_list = NULL;
+
+// read up to k uncommitted pages of shm from the disk, starting with page i
+bool shm_read(shm_t *shm, uint32_t i, uint32_t k)
+{
+  uint32_t n = shm->size >> PAGE_SHIFT;
+
+  for (uint32_t j = i; (j < n) && (j < (i + k)) && (shm->frames[j] == 0); j++)
+  {
+    uint32_t pa = vm_frame_alloc();
+
+    if (pa == 0)
+    {
+      break;
+    }
+
+    if (disk_rd_n(shm->block + (j * swap_blocks), (uint8_t *)(pa), swap_block_len, swap_blocks) != DISK_SUCCESS)
+    {
+      page_put(pa);
+      break;
+    }
+
+    shm->frames[j] = pa;
+  }
+
+  return shm->frames[i] != 0;
+}
+
+// make every mapping of page i of shm (i.e., of frame pa) read-only again
+void shm_protect(shm_t *shm, uint32_t i, uint32_t pa)
+{
+  uint32_t x = i << PAGE_SHIFT;
+
+  for (pcb_t *p = proc_list; p != NULL; p = p->next)
+  {
+    if (p->as == NULL)
+    {
+      continue;
+    }
+
+    for (vm_region_t *r = p->as->regions; r != NULL; r = r->next)
+    {
+      if ((r->shm != shm) || (x < r->offset) || ((x - r->offset) >= (r->end - r->start)))
+      {
+        continue;
+      }
+
+      uint32_t va = r->start + (x - r->offset);
+      uint32_t *pte = vm_pte(p->as, va, false);
+
+      if ((pte != NULL) && PTE_L2_VALID(*pte) && ((*pte & ~(PAGE_SIZE - 1)) == pa))
+      {
+        vm_set_pte(p->as, pte, va, *pte | PTE_L2_APX);
+      }
+    }
+  }
+}
+
+shm_t *shm_lookup(uint32_t x)
+{
+  for (shm_t *shm = shm_list; shm != NULL; shm = shm->next)
+  {
+    if (shm->key == x)
+    {
+      return shm;
+    }
+  }
+
+  return NULL;
+}
+
+shm_t *shm_create(uint32_t x, uint32_t n)
+{
+  n = (n + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+  if ((n == 0) || (n > (SHM_PAGES * PAGE_SIZE)) || ((x != 0) && (shm_lookup(x) != NULL)))
+  {
+    return NULL;
+  }
+
+  shm_t *shm = slab_alloc(&shm_cache);
+
+  if (shm == NULL)
+  {
+    return NULL;
+  }
+
+  shm->frames = (uint32_t *)(page_alloc(0));
+
+  if (shm->frames == NULL)
+  {
+    slab_free(&shm_cache, shm);
+    return NULL;
+  }
+
+  memset(shm->frames, 0, (n >> PAGE_SHIFT) * sizeof(uint32_t));
+
+  shm->key = x;
+  shm->size = n;
+  shm->refs = 1;
+  shm->block = SHM_NONE;
+  shm->last = SHM_NONE;
+  shm->next = NULL;
+
+  if (x != 0)
+  {
+    shm->next = shm_list;
+    shm_list = shm;
+  }
+
+  return shm;
+}
+
+shm_t *shm_create_disk(uint32_t a, uint32_t n)
+{
+  n = (n + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+  if (!swap_probe() || (a > swap_base) || ((n >> PAGE_SHIFT) > ((swap_base - a) / swap_blocks)))
+  {
+    return NULL;
+  }
+
+  shm_t *shm = shm_create(0, n);
+
+  if (shm != NULL)
+  {
+    shm->block = a;
+  }
+
+  return shm;
+}
+
+void shm_get(shm_t *shm)
+{
+  shm->refs++;
+}
+
+void shm_put(shm_t *shm)
+{
+  if (--shm->refs > 0)
+  {
+    return;
+  }
+
+  if (shm->key != 0)
+  {
+    for (shm_t **p = &shm_list; *p != NULL; p = &(*p)->next)
+    {
+      if (*p == shm)
+      {
+        *p = shm->next;
+        break;
+      }
+    }
+  }
+
+  shm_sync(shm, 0, shm->size >> PAGE_SHIFT);
+
+  for (uint32_t i = 0; i < (shm->size >> PAGE_SHIFT); i++)
+  {
+    if (shm->frames[i] != 0)
+    {
+      page_put(shm->frames[i] & ~(PAGE_SIZE - 1));
+    }
+  }
+
+  page_put((uint32_t)(shm->frames));
+  slab_free(&shm_cache, shm);
+}
+
+uint32_t shm_frame(shm_t *shm, uint32_t i)
+{
+  if (i >= (shm->size >> PAGE_SHIFT))
+  {
+    return 0;
+  }
+
+  if ((shm->frames[i] == 0) && (shm->block != SHM_NONE))
+  {
+    if (!shm_read(shm, i, (i == (shm->last + 1)) ? (1 + SHM_AHEAD) : 1))
+    {
+      return 0;
+    }
+  }
+  else if (shm->frames[i] == 0)
+  {
+    uint32_t pa = page_alloc(0);
+
+    if (pa == 0)
+    {
+      return 0;
+    }
+
+    memset((void *)(pa), 0, PAGE_SIZE);
+    shm->frames[i] = pa;
+  }
+
+  shm->last = i;
+
+  return shm->frames[i] & ~(PAGE_SIZE - 1);
+}
+
+bool shm_clean(shm_t *shm, uint32_t i)
+{
+  return (shm->block != SHM_NONE) && !(shm->frames[i] & SHM_DIRTY);
+}
+
+void shm_dirty(shm_t *shm, uint32_t i)
+{
+  shm->frames[i] |= SHM_DIRTY;
+}
+
+bool shm_sync(shm_t *shm, uint32_t i, uint32_t j)
+{
+  bool r = true;
+
+  if (shm->block == SHM_NONE)
+  {
+    return r;
+  }
+
+  for (; (i < j) && (i < (shm->size >> PAGE_SHIFT)); i++)
+  {
+    uint32_t cpsr = int_save_irq();
+
+    if (!(shm->frames[i] & SHM_DIRTY))
+    {
+      int_restore_irq(cpsr);
+      continue;
+    }
+
+    uint32_t pa = shm->frames[i] & ~(PAGE_SIZE - 1);
+
+    // protect and mark clean first, so any write during or after this one
+    // faults and marks it dirty again
+    shm_protect(shm, i, pa);
+    shm->frames[i] = pa;
+
+    // write with IRQs enabled, but with no context switch (so no other disk
+    // user) until it completes
+    preempt_count++;
+    int_enable_irq();
+
+    bool done = (disk_wr_n(shm->block + (i * swap_blocks), (uint8_t *)(pa), swap_block_len, swap_blocks) == DISK_SUCCESS);
+
+    int_unable_irq();
+    preempt_count--;
+
+    if (!done)
+    {
+      shm->frames[i] |= SHM_DIRTY;
+      r = false;
+    }
+
+    int_restore_irq(cpsr);
+  }
+
+  return r;
+}
@@ -0,0 +1,81 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __SHM_H
+#define __SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A shared memory object is a set of frames that several address spaces
+ * can map at once, so processes can exchange data without copying it in
+ * and out of the kernel (a pipe can then be used only for notification).
+ * Each object is either named by a non-zero key, so unrelated processes
+ * can find it, or anonymous, in which case it is shared only via fork.
+ *
+ * An object is reference counted: each region that maps it (see vm.h)
+ * holds a reference, and once the last is dropped the frames are freed
+ * and a named object is forgotten.  Frames are committed on demand, i.e.,
+ * when some process first touches the page, and the object holds one
+ * reference to each frame in addition to those its mappings hold.
+ *
+ * An anonymous object may instead be backed by a range of disk blocks,
+ * i.e., the blocks below swap_base (see swap.h), which lets a process map
+ * the disk into memory.  Committing a page then reads it from the disk
+ * rather than zeroing it; if the faults so far are sequential, the next
+ * SHM_AHEAD pages are read and mapped as well (see vm_fault), so a scan
+ * takes one fault per 1 + SHM_AHEAD pages rather than one per page.  A
+ * clean page is mapped read-only, so the first write faults and marks it
+ * dirty (in bit 0 of the frame table entry) before making it writable.
+ * shm_sync writes dirty pages back, and makes them read-only again in
+ * every address space that maps them; dropping the last reference syncs
+ * the whole object.  The write-back (from msync, shmunmap, or the exit or
+ * shmunmap that drops the last reference) polls UART2 with IRQs enabled,
+ * but preemption disabled, so other disk users cannot interleave with it.
+ * Mapping the same blocks twice, other than via fork, gives independent
+ * copies, so writes to one are not seen in the other until it is synced.
+ */
+
+#define SHM_PAGES ( 1024 ) // i.e., 4MB, so the frame table fits in one page
+#define SHM_AHEAD ( 4 )    // pages read ahead of a sequential fault
+#define SHM_DIRTY ( 0x1 )  // page written to since last synced
+#define SHM_NONE  ( 0xFFFFFFFF )
+
+typedef struct shm
+{
+  uint32_t key;      // name, or 0 if anonymous
+  uint32_t size;     // size in bytes, a multiple of the page size
+  uint32_t refs;     // regions that map the object
+  uint32_t *frames;  // frame for each page (plus SHM_DIRTY), or 0 if not yet committed
+  uint32_t block;    // first disk block, or SHM_NONE if not backed by the disk
+  uint32_t last;     // page last committed, to detect sequential faults
+  struct shm *next;  // next object in shm_list, iff. named
+} shm_t;
+
+extern shm_t *shm_list;
+
+// return the named object with key x, or NULL if there is none
+extern shm_t *shm_lookup(uint32_t x);
+// create an object of n bytes with key x (or anonymous iff. x = 0), with one reference
+extern shm_t *shm_create(uint32_t x, uint32_t n);
+// create an anonymous object of n bytes backed by disk blocks from a onward, with one reference
+extern shm_t *shm_create_disk(uint32_t a, uint32_t n);
+// take a reference to shm
+extern void shm_get(shm_t *shm);
+// drop a reference to shm, deallocating it when the last one is dropped
+extern void shm_put(shm_t *shm);
+// return the frame holding page i of shm, committing one iff. need be, or 0 on failure
+extern uint32_t shm_frame(shm_t *shm, uint32_t i);
+// return true iff. page i of shm is backed by the disk, and not yet written to
+extern bool shm_clean(shm_t *shm, uint32_t i);
+// mark page i of shm as written to
+extern void shm_dirty(shm_t *shm, uint32_t i);
+// write dirty pages [i, j) of shm back to the disk; return false on failure
+extern bool shm_sync(shm_t *shm, uint32_t i, uint32_t j);
+
+#endif
@@ -0,0 +1,98 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+slab_cache_t *slab_caches = NULL;
+
+bool slab_grow(slab_cache_t *c)
+{
+  if (c->slabs == 0)
+  {
+    c->order = page_order(SLAB_MIN_OBJECTS * c->size);
+  }
+
+  uint8_t *slab = (uint8_t *)(page_alloc(c->order));
+
+  if (slab == NULL)
+  {
+    return false;
+  }
+  if (c->slabs == 0)
+  {
+    c->next = slab_caches;
+    slab_caches = c;
+  }
+
+  uint32_t n = (PAGE_SIZE << c->order) / c->size;
+
+  memset(slab, 0, PAGE_SIZE << c->order);
+
+  // push in reverse order, so objects are allocated in address order
+  for (int i = n - 1; i >= 0; i--)
+  {
+    void *x = slab + (i * c->size);
+
+    if (c->ctor != NULL)
+    {
+      c->ctor(x);
+    }
+
+    *(void **)(x) = c->free;
+    c->free = x;
+  }
+
+  c->slabs++;
+  c->total += n;
+
+  return true;
+}
+
+void *slab_alloc(slab_cache_t *c)
+{
+  if ((c->free == NULL) && !slab_grow(c))
+  {
+    return NULL;
+  }
+
+  void *x = c->free;
+  c->free = *(void **)(x);
+
+  if (++c->used > c->peak)
+  {
+    c->peak = c->used;
+  }
+
+  return x;
+}
+
+void slab_free(slab_cache_t *c, void *x)
+{
+  *(void **)(x) = c->free;
+  c->free = x;
+
+  c->used--;
+}
+
+int slab_info(slab_info_t *x, int n)
+{
+  int i = 0;
+
+  for (slab_cache_t *c = slab_caches; c != NULL; c = c->next, i++)
+  {
+    if (i < n)
+    {
+      strncpy(x[i].name, c->name, sizeof(x[i].name));
+      x[i].size = c->size;
+      x[i].used = c->used;
+      x[i].total = c->total;
+      x[i].peak = c->peak;
+    }
+  }
+
+  return i;
+}
@@ -0,0 +1,69 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __SLAB_H
+#define __SLAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fixed-size kernel objects (e.g., PCBs and pipes) are allocated from a
+ * per-type cache: each cache carves blocks from the page allocator (i.e.,
+ * slabs) into objects, and keeps those not in use on a free list threaded
+ * through the first word of each.  Allocation and deallocation therefore
+ * take constant time, and the list is LIFO so the most recently freed
+ * (i.e., most likely cache-hot) object is reused first.
+ *
+ * An optional constructor is applied once per object, when its slab is
+ * created, rather than on every allocation: this lets an object keep some
+ * state (e.g., a generation count) across reuse, so long as it is not in
+ * the first word.  Slabs are never returned to the page allocator.
+ *
+ * Each cache counts objects in use, plus the peak; a count that only ever
+ * increases points to a leak.  A cache is declared statically using
+ * SLAB_CACHE, and is added to slab_caches when its first slab is created.
+ */
+
+#define SLAB_MIN_OBJECTS ( 8 ) // per slab, which determines its order
+
+typedef struct slab_cache
+{
+  char *name;
+  size_t size;              // object size, rounded up to a multiple of 8
+  void (*ctor)(void *);     // constructor, or NULL if none
+  int order;                // order of each slab
+
+  void *free;               // free objects, most recently freed first
+
+  uint32_t slabs;           // number of slabs
+  uint32_t total;           // number of objects in those slabs
+  uint32_t used;            // number of objects allocated
+  uint32_t peak;            // maximum of used
+
+  struct slab_cache *next;  // next cache in slab_caches
+} slab_cache_t;
+
+// per-cache statistics, as reported to user space
+typedef struct
+{
+  char name[8];
+  uint32_t size, used, total, peak;
+} slab_info_t;
+
+#define SLAB_CACHE( n, t, c ) { .name = ( n ), .size = ( ( sizeof( t ) + 7 ) & ~7 ), .ctor = ( c ) }
+
+extern slab_cache_t *slab_caches;
+
+// allocate an object from cache c, or return NULL if none is available
+extern void *slab_alloc(slab_cache_t *c);
+// return object x to cache c
+extern void slab_free(slab_cache_t *c, void *x);
+// store statistics for up to n caches in x; return number of caches
+extern int slab_info(slab_info_t *x, int n);
+
+#endif
@@ -0,0 +1,334 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+uint32_t swap_disk_blocks = 0;
+uint32_t swap_block_len = 0;
+uint32_t swap_blocks = 0;
+uint32_t swap_base = 0;
+
+uint32_t swap_slots = 0;
+uint32_t swap_used = 0;
+uint32_t swap_outs = 0;
+uint32_t swap_ins = 0;
+
+uint16_t *swap_refs = NULL;  // reference count for each slot
+uint32_t swap_next = 0;      // slot to start the next search from
+uint8_t *swap_buffer = NULL; // bounce buffer for a cluster
+bool swap_busy = false;      // true iff. swap_buffer is being written out
+
+work_t swap_work;
+
+uint32_t swap_free_pages()
+{
+  uint32_t n = 0;
+
+  for (int k = 0; k < PAGE_ORDERS; k++)
+  {
+    n += page_free_count[k] << k;
+  }
+
+  return n;
+}
+
+void swap_reclaim(void *arg)
+{
+  while ((swap_free_pages() < SWAP_HIGH) && (swap_out(SWAP_CLUSTER) > 0))
+  {
+    continue;
+  }
+}
+
+bool swap_probe()
+{
+  if (!DISK_ENABLE)
+  {
+    return false;
+  }
+  if (swap_disk_blocks != 0)
+  {
+    return true;
+  }
+
+  int n = disk_get_block_num();
+  int m = disk_get_block_len();
+
+  if ((n <= 0) || (m <= 0) || (m > PAGE_SIZE) || ((PAGE_SIZE % m) != 0))
+  {
+    return false;
+  }
+
+  swap_block_len = m;
+  swap_blocks = PAGE_SIZE / m;
+  swap_base = n; // i.e., no swap area, until swap_init reserves one
+  swap_disk_blocks = n;
+
+  return true;
+}
+
+void swap_init()
+{
+  if (!SWAP_ENABLE || !swap_probe())
+  {
+    return;
+  }
+
+  uint32_t slots = (swap_disk_blocks / 2) / swap_blocks;
+
+  swap_refs = (uint16_t *)(page_alloc(page_order(slots * sizeof(uint16_t))));
+  swap_buffer = (uint8_t *)(page_alloc(SWAP_ORDER));
+
+  if ((slots == 0) || (swap_refs == NULL) || (swap_buffer == NULL))
+  {
+    if (swap_refs != NULL)
+    {
+      page_put((uint32_t)(swap_refs));
+    }
+    if (swap_buffer != NULL)
+    {
+      page_put((uint32_t)(swap_buffer));
+    }
+
+    return;
+  }
+
+  memset(swap_refs, 0, slots * sizeof(uint16_t));
+  work_init(&swap_work, swap_reclaim, NULL);
+
+  swap_base = swap_disk_blocks - (slots * swap_blocks);
+  swap_slots = slots;
+}
+
+void swap_get(uint32_t s)
+{
+  swap_refs[s]++;
+}
+
+void swap_put(uint32_t s)
+{
+  if (--swap_refs[s] == 0)
+  {
+    swap_used--;
+  }
+}
+
+// allocate k adjacent slots, next fit, or return SWAP_NONE if there are none
+uint32_t swap_alloc(int k)
+{
+  for (int pass = 0; pass < 2; pass++)
+  {
+    int run = 0;
+
+    for (uint32_t s = (pass == 0) ? swap_next : 0; s < swap_slots; s++)
+    {
+      run = (swap_refs[s] == 0) ? (run + 1) : 0;
+
+      if (run == k)
+      {
+        for (uint32_t i = s + 1 - k; i <= s; i++)
+        {
+          swap_refs[i] = 1;
+        }
+
+        swap_used += k;
+        swap_next = s + 1;
+
+        return s + 1 - k;
+      }
+    }
+  }
+
+  return SWAP_NONE;
+}
+
+// return true iff. pte is already one of the k victims in v, since a later
+// pass (or another thread sharing the address space) may scan it again
+bool swap_chosen(swap_victim_t *v, int k, uint32_t *pte)
+{
+  for (int i = 0; i < k; i++)
+  {
+    if (v[i].pte == pte)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// advance the clock hand of as over (at most) one revolution, ageing each
+// valid page it passes and adding aged ones as victims to the k in v, until
+// there are n; return the new number of victims
+int swap_scan(as_t *as, swap_victim_t *v, int k, int n)
+{
+  uint32_t va = as->clock;
+
+  for (uint32_t i = 0; (i < (USER_LIMIT - USER_BASE)) && (k < n);)
+  {
+    uint32_t *pte = vm_pte(as, va, false);
+    uint32_t step = PAGE_SIZE;
+
+    if (pte == NULL)
+    {
+      step = VM_SECTION_SIZE - (va & (VM_SECTION_SIZE - 1));
+    }
+    else if (PTE_L2_FRAME(*pte) && page_managed(*pte & ~(PAGE_SIZE - 1)) && (page_refs(*pte & ~(PAGE_SIZE - 1)) == 1))
+    {
+      if (PTE_L2_VALID(*pte))
+      {
+        vm_set_pte(as, pte, va, *pte & ~0x3);
+      }
+      else if (!swap_chosen(v, k, pte))
+      {
+        v[k].as = as;
+        v[k].pte = pte;
+        v[k].va = va;
+        k++;
+      }
+    }
+
+    i += step;
+    va += step;
+
+    if (va >= USER_LIMIT)
+    {
+      va = USER_BASE;
+    }
+  }
+
+  as->clock = va;
+
+  return k;
+}
+
+int swap_out(int n)
+{
+  if ((swap_slots == 0) || (n <= 0))
+  {
+    return 0;
+  }
+
+  swap_victim_t v[SWAP_CLUSTER];
+  uint32_t x[SWAP_CLUSTER];
+  int k = 0;
+
+  n = (n > SWAP_CLUSTER) ? SWAP_CLUSTER : n;
+
+  // nothing else may run (so touch a victim) while victims are chosen and
+  // copied into the bounce buffer
+  uint32_t cpsr = int_save_irq();
+
+  if (swap_busy)
+  {
+    int_restore_irq(cpsr);
+    return 0;
+  }
+
+  // blocked processes first, then ready ones: each gets two passes, since
+  // the first may only age pages used since the hand last passed them; a
+  // thread sharing the executing address space is skipped, like it
+  for (int pass = 0; (pass < 4) && (k < n); pass++)
+  {
+    status_t status = (pass < 2) ? STATUS_WAITING : STATUS_READY;
+
+    for (pcb_t *p = proc_list; (p != NULL) && (k < n); p = p->next)
+    {
+      if ((p->as != NULL) && (p->as != executing->as) && (p->status == status))
+      {
+        k = swap_scan(p->as, v, k, n);
+      }
+    }
+  }
+
+  uint32_t s = SWAP_NONE;
+
+  while ((k > 0) && ((s = swap_alloc(k)) == SWAP_NONE))
+  {
+    k--;
+  }
+
+  if (k == 0)
+  {
+    int_restore_irq(cpsr);
+    return 0;
+  }
+
+  for (int i = 0; i < k; i++)
+  {
+    x[i] = *v[i].pte;
+    memcpy(swap_buffer + (i * PAGE_SIZE), (void *)(x[i] & ~(PAGE_SIZE - 1)), PAGE_SIZE);
+  }
+
+  // write the cluster with IRQs enabled, but with no context switch (so no
+  // other disk user, nor any process that could exit and free a victim)
+  // until it completes; swap_busy keeps the bounce buffer ours meanwhile
+  swap_busy = true;
+  preempt_count++;
+  int_restore_irq(cpsr);
+
+  bool done = (disk_wr_n(swap_base + (s * swap_blocks), swap_buffer, swap_block_len, k * swap_blocks) == DISK_SUCCESS);
+
+  cpsr = int_save_irq();
+  preempt_count--;
+  swap_busy = false;
+
+  // a victim is aged, so any access since it was copied (e.g., by deferred
+  // work in kernel mode) faulted and changed the entry: keep such a page
+  // resident, and drop its slot
+  int m = 0;
+
+  for (int i = 0; i < k; i++)
+  {
+    if (done && (*v[i].pte == x[i]))
+    {
+      vm_set_pte(v[i].as, v[i].pte, v[i].va, PTE_L2_SWAP(s + i));
+      page_put(x[i] & ~(PAGE_SIZE - 1));
+      m++;
+    }
+    else
+    {
+      swap_put(s + i);
+    }
+  }
+
+  swap_outs += m;
+  int_restore_irq(cpsr);
+
+  return m;
+}
+
+bool swap_in(as_t *as, uint32_t *pte, uint32_t va)
+{
+  uint32_t s = PTE_L2_SLOT(*pte);
+  uint32_t pa = vm_frame_alloc();
+
+  // only a process using as faults, and swap_out never picks a page of the
+  // executing address space, so the entry cannot change meanwhile
+  if (pa == 0)
+  {
+    return false;
+  }
+
+  if (disk_rd_n(swap_base + (s * swap_blocks), (uint8_t *)(pa), swap_block_len, swap_blocks) != DISK_SUCCESS)
+  {
+    page_put(pa);
+    return false;
+  }
+
+  swap_ins++;
+
+  return vm_map_page(as, va, pa, PAGE_USER); // drops the reference to the slot
+}
+
+void swap_balance()
+{
+  if ((swap_slots != 0) && (swap_free_pages() < SWAP_LOW))
+  {
+    kworker_schedule(&swap_work);
+  }
+}
@@ -0,0 +1,95 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __SWAP_H
+#define __SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "disk.h"
+#include "vm.h"
+
+/* Swap lets the kernel run more processes than RAM can hold: under memory
+ * pressure, cold pages of processes that are blocked (or, failing that,
+ * ready but not executing) are written to disk.bin (via device/disk.py on
+ * UART2), and their frames freed; the next access faults, and vm_fault
+ * reads the page back.  The top half of the disk is used as swap, from
+ * block swap_base upward, divided into page-sized slots (the rest may be
+ * mapped by processes, see shm.h); a slot is reference counted, since a
+ * fork shares the swapped pages of the parent with the child.
+ *
+ * Victims are chosen by a clock (i.e., approximate LRU) scan: the MMU has
+ * no referenced bit, so the scan ages a valid page instead (see vm.h),
+ * making the next access fault and mark it referenced again.  A page the
+ * scan finds still aged has not been used for a whole revolution of the
+ * hand, so is evicted.  Only pages private to one address space (i.e.,
+ * with one reference) are candidates.
+ *
+ * Each request to disk.py transfers one small block, so the UART link is
+ * the bottleneck: victims are gathered into clusters of SWAP_CLUSTER pages,
+ * copied into a bounce buffer, and written to adjacent slots with many
+ * requests in flight at once.  A larger DISK_BLOCK_LEN (e.g., 4096, up to
+ * the page size) in Makefile.disk cuts the number of round-trips further.
+ * IRQs are only disabled while victims are chosen and copied: the write
+ * itself is done with them enabled but preemption disabled, since the
+ * requests of another disk user must not interleave with it.  A victim is
+ * aged, so one touched meanwhile faults, which the commit then detects.
+ *
+ * The disk is only used iff. DISK_ENABLE is non-zero, since it requires
+ * UART2 to be connected (see QEMU_UART in Makefile) and the disk launched
+ * (i.e., make launch-disk): otherwise the first request would never get a
+ * response, so swap_probe fails (as does dmap) rather than hang.  Swap is
+ * then only enabled iff. SWAP_ENABLE is non-zero too.  Reclaim is direct
+ * (i.e., when a fault finds no free frame), and in the background, by a
+ * kernel worker, whenever a tick finds fewer than SWAP_LOW free pages,
+ * until SWAP_HIGH are free again.
+ */
+
+#define DISK_ENABLE  ( 0 )
+#define SWAP_ENABLE  ( 0 )
+#define SWAP_CLUSTER ( 8 )   // pages written per cluster
+#define SWAP_ORDER   ( 3 )   // i.e., a bounce buffer of SWAP_CLUSTER pages
+#define SWAP_LOW     ( 256 ) // free pages, below which reclaim starts
+#define SWAP_HIGH    ( 512 ) // free pages, at which reclaim stops
+#define SWAP_NONE    ( 0xFFFFFFFF )
+
+// a page chosen for eviction, i.e., an aged entry
+typedef struct
+{
+  as_t *as;      // address space
+  uint32_t *pte; // entry
+  uint32_t va;   // address
+} swap_victim_t;
+
+extern uint32_t swap_disk_blocks; // disk block count, or 0 iff. not yet probed
+extern uint32_t swap_block_len;   // disk block length
+extern uint32_t swap_blocks;      // disk blocks per page
+extern uint32_t swap_base;        // first disk block used for swap
+
+extern uint32_t swap_slots;  // number of slots, or 0 iff. swap is disabled
+extern uint32_t swap_used;   // number of slots in use
+extern uint32_t swap_outs;   // pages written to swap
+extern uint32_t swap_ins;    // pages read back from swap
+
+// query the disk geometry, once; return false if it is unusable
+extern bool swap_probe();
+// size the swap area and allocate the slot table, iff. enabled
+extern void swap_init();
+// take a reference to slot s
+extern void swap_get(uint32_t s);
+// drop a reference to slot s, freeing it when the last one is dropped
+extern void swap_put(uint32_t s);
+// swap out up to n (at most SWAP_CLUSTER) pages; return the number swapped out
+extern int swap_out(int n);
+// read the page swapped out at va (with entry pte) back in
+extern bool swap_in(as_t *as, uint32_t *pte, uint32_t va);
+// start background reclaim iff. free memory is low
+extern void swap_balance();
+
+#endif
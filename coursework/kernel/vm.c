@@ -0,0 +1,924 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+uint32_t vm_kernel_pt[VM_L1_ENTRIES] __attribute__((aligned(16384)));
+
+extern uint32_t user_load;
+extern uint32_t user_data_end;
+extern uint32_t user_bss_end;
+extern uint32_t image_end;
+
+slab_cache_t as_cache = SLAB_CACHE("as", as_t, NULL);
+slab_cache_t region_cache = SLAB_CACHE("region", vm_region_t, NULL);
+
+as_t *vm_current = NULL;
+as_t *vm_image = NULL;
+uint32_t vm_asid_generation = 1 << ASID_BITS;
+uint32_t vm_asid_next = 1;
+
+void vm_map_sections(uint32_t *pt, uint32_t x, uint32_t n, uint32_t a)
+{
+  for (uint32_t i = 0; i < (n >> VM_SECTION_SHIFT); i++)
+  {
+    uint32_t va = x + (i << VM_SECTION_SHIFT);
+    pt[va >> VM_SECTION_SHIFT] = va | a;
+  }
+}
+
+void vm_init()
+{
+  memset(vm_kernel_pt, 0, sizeof(vm_kernel_pt));
+
+  vm_map_sections(vm_kernel_pt, RAM_ALIAS_BASE, RAM_ALIAS_SIZE, SECTION_NORMAL);
+  vm_map_sections(vm_kernel_pt, DEV_BASE, DEV_SIZE, SECTION_DEVICE);
+  vm_map_sections(vm_kernel_pt, RAM_BASE, RAM_SIZE, SECTION_NORMAL);
+  kdata_map(vm_kernel_pt);
+
+  mmu_set_dom(0, 0x1); // set domain 0 to 01_{(2)} => client (i.e., check AP)
+  mmu_set_ptr0(vm_kernel_pt);
+
+  mmu_flush();
+  cache_invalidate_icache();
+  mmu_enable();
+
+  if (VM_CACHES)
+  {
+    cache_enable();
+  }
+
+}
+
+void vm_image_init()
+{
+  vm_image = vm_as_create();
+
+  // the bss needs no pristine copy, since exec reserves it as a region
+  for (uint32_t va = USER_BASE; va < (uint32_t)(&user_data_end); va += VM_PAGE_SIZE)
+  {
+    uint32_t pa = page_alloc(0);
+
+    memcpy((void *)(pa), (uint8_t *)(&user_load) + (va - USER_BASE), VM_PAGE_SIZE);
+    vm_map_page(vm_image, va, pa, PAGE_USER);
+  }
+}
+
+as_t *vm_as_create()
+{
+  as_t *as = slab_alloc(&as_cache);
+
+  if (as == NULL)
+  {
+    return NULL;
+  }
+
+  as->l1 = (uint32_t *)(page_alloc(VM_L1_ORDER));
+  as->asid = 0;
+  as->regions = NULL;
+  as->brk = USER_HEAP_BASE;
+  as->clock = USER_BASE;
+  as->refs = 1;
+
+  if (as->l1 == NULL)
+  {
+    slab_free(&as_cache, as);
+    return NULL;
+  }
+
+  // table walks do not look in the L1 D-cache, so clean the copy to memory
+  memcpy(as->l1, vm_kernel_pt, sizeof(vm_kernel_pt));
+  cache_clean(as->l1, sizeof(vm_kernel_pt));
+
+  return as;
+}
+
+void vm_as_destroy(as_t *as)
+{
+  while (as->regions != NULL)
+  {
+    vm_region_t *r = as->regions;
+
+    as->regions = r->next;
+
+    if (r->shm != NULL)
+    {
+      shm_put(r->shm);
+    }
+
+    slab_free(&region_cache, r);
+  }
+
+  for (uint32_t i = USER_BASE >> VM_SECTION_SHIFT; i < USER_LIMIT >> VM_SECTION_SHIFT; i += VM_L2_GROUP)
+  {
+    uint32_t group = 0;
+
+    for (int k = 0; k < VM_L2_GROUP; k++)
+    {
+      if ((as->l1[i + k] & 0x3) != PTE_L1_COARSE)
+      {
+        continue;
+      }
+
+      uint32_t *l2 = (uint32_t *)(as->l1[i + k] & ~0x3FF);
+
+      for (int j = 0; j < VM_L2_ENTRIES; j++)
+      {
+        vm_pte_release(l2[j]);
+      }
+
+      group = (uint32_t)(l2) & ~(VM_PAGE_SIZE - 1);
+    }
+
+    if (group != 0)
+    {
+      page_put(group);
+    }
+  }
+
+  // any TLB entries left are tagged with an ASID not reused until rollover
+  page_put((uint32_t)(as->l1));
+  slab_free(&as_cache, as);
+}
+
+void vm_as_get(as_t *as)
+{
+  as->refs++;
+}
+
+void vm_as_put(as_t *as)
+{
+  if (--as->refs == 0)
+  {
+    vm_as_destroy(as);
+  }
+}
+
+uint32_t *vm_pte(as_t *as, uint32_t va, bool alloc)
+{
+  uint32_t i = va >> VM_SECTION_SHIFT;
+
+  if ((as->l1[i] & 0x3) != PTE_L1_COARSE)
+  {
+    if (!alloc)
+    {
+      return NULL;
+    }
+
+    // use the page holding the tables for adjacent sections, if there is one
+    uint32_t base = i & ~(VM_L2_GROUP - 1);
+    uint32_t group = 0;
+
+    for (int k = 0; k < VM_L2_GROUP; k++)
+    {
+      if ((as->l1[base + k] & 0x3) == PTE_L1_COARSE)
+      {
+        group = as->l1[base + k] & ~(VM_PAGE_SIZE - 1);
+        break;
+      }
+    }
+
+    if (group == 0)
+    {
+      group = page_alloc(0);
+
+      if (group == 0)
+      {
+        return NULL;
+      }
+
+      memset((void *)(group), 0, VM_PAGE_SIZE);
+      cache_clean((void *)(group), VM_PAGE_SIZE);
+    }
+
+    as->l1[i] = (group + (i - base) * VM_L2_ENTRIES * sizeof(uint32_t)) | PTE_DOMAIN(0) | PTE_L1_COARSE;
+    cache_clean(&as->l1[i], sizeof(uint32_t));
+  }
+
+  uint32_t *l2 = (uint32_t *)(as->l1[i] & ~0x3FF);
+
+  return &l2[(va >> VM_PAGE_SHIFT) & (VM_L2_ENTRIES - 1)];
+}
+
+void vm_set_pte(as_t *as, uint32_t *pte, uint32_t va, uint32_t x)
+{
+  *pte = x;
+  cache_clean(pte, sizeof(uint32_t));
+
+  // only a live ASID can have a (now stale) entry for va in the TLB
+  if ((as->asid & ~ASID_MASK) == vm_asid_generation)
+  {
+    mmu_flush_va((va & ~(VM_PAGE_SIZE - 1)) | (as->asid & ASID_MASK));
+  }
+}
+
+uint32_t vm_frame_alloc()
+{
+  uint32_t pa = page_alloc(0);
+
+  // under pressure, reclaim frames by swapping out cold pages, then retry
+  if ((pa == 0) && (swap_out(SWAP_CLUSTER) > 0))
+  {
+    pa = page_alloc(0);
+  }
+
+  return pa;
+}
+
+void vm_pte_release(uint32_t x)
+{
+  if (PTE_L2_FRAME(x))
+  {
+    page_put(x & ~(VM_PAGE_SIZE - 1));
+  }
+  else if (PTE_L2_SWAPPED(x))
+  {
+    swap_put(PTE_L2_SLOT(x));
+  }
+}
+
+bool vm_map_page(as_t *as, uint32_t va, uint32_t pa, uint32_t a)
+{
+  uint32_t *pte = vm_pte(as, va, true);
+
+  if (pte == NULL)
+  {
+    return false;
+  }
+
+  uint32_t x = *pte;
+
+  vm_set_pte(as, pte, va, (pa & ~(VM_PAGE_SIZE - 1)) | a);
+  vm_pte_release(x);
+
+  return true;
+}
+
+void vm_unmap_page(as_t *as, uint32_t va)
+{
+  uint32_t *pte = vm_pte(as, va, false);
+
+  if ((pte == NULL) || (*pte == 0))
+  {
+    return;
+  }
+
+  uint32_t x = *pte;
+
+  vm_set_pte(as, pte, va, 0);
+  vm_pte_release(x);
+}
+
+uint32_t vm_resident(as_t *as)
+{
+  uint32_t n = 0;
+
+  for (uint32_t i = USER_BASE >> VM_SECTION_SHIFT; i < USER_LIMIT >> VM_SECTION_SHIFT; i++)
+  {
+    if ((as->l1[i] & 0x3) != PTE_L1_COARSE)
+    {
+      continue;
+    }
+
+    uint32_t *l2 = (uint32_t *)(as->l1[i] & ~0x3FF);
+
+    for (int j = 0; j < VM_L2_ENTRIES; j++)
+    {
+      if (PTE_L2_FRAME(l2[j]))
+      {
+        n++;
+      }
+    }
+  }
+
+  return n;
+}
+
+bool vm_region_insert(as_t *as, uint32_t start, uint32_t end, uint32_t fill, shm_t *shm, uint32_t offset, bool merge)
+{
+  if ((start >= end) || (start < USER_BASE) || (end > USER_LIMIT) || ((start | end) & (VM_PAGE_SIZE - 1)))
+  {
+    return false;
+  }
+
+  // the list is kept in address order, so find where the region goes
+  vm_region_t **r = &as->regions;
+  vm_region_t *prev = NULL;
+
+  while ((*r != NULL) && ((*r)->end <= start))
+  {
+    prev = *r;
+    r = &(*r)->next;
+  }
+
+  if ((*r != NULL) && ((*r)->start < end))
+  {
+    return false;
+  }
+
+  // extend the private region just below with the same fill, rather than
+  // add one, iff. merge (i.e., sbrk growing the heap region); never extend
+  // the one above, which may be a separate mapping
+  if (merge && (shm == NULL) && (prev != NULL) && (prev->shm == NULL) && (prev->end == start) && (prev->fill == fill))
+  {
+    prev->end = end;
+    return true;
+  }
+
+  vm_region_t *x = slab_alloc(&region_cache);
+
+  if (x == NULL)
+  {
+    return false;
+  }
+
+  x->start = start;
+  x->end = end;
+  x->fill = fill;
+  x->shm = shm;
+  x->offset = offset;
+  x->next = *r;
+  *r = x;
+
+  if (shm != NULL)
+  {
+    shm_get(shm);
+  }
+
+  return true;
+}
+
+bool vm_region_add(as_t *as, uint32_t start, uint32_t end, uint32_t fill, bool merge)
+{
+  return vm_region_insert(as, start, end, fill, NULL, 0, merge);
+}
+
+bool vm_region_map(as_t *as, uint32_t start, uint32_t end, shm_t *shm, uint32_t x)
+{
+  if ((x > shm->size) || ((end - start) > (shm->size - x)))
+  {
+    return false;
+  }
+
+  return vm_region_insert(as, start, end, 0, shm, x, false);
+}
+
+bool vm_region_remove(as_t *as, uint32_t start, uint32_t end)
+{
+  start = start & ~(VM_PAGE_SIZE - 1);
+  end = (end + VM_PAGE_SIZE - 1) & ~(VM_PAGE_SIZE - 1);
+
+  vm_region_t **r = &as->regions;
+
+  while (*r != NULL)
+  {
+    vm_region_t *x = *r;
+
+    if ((x->end <= start) || (x->start >= end))
+    {
+      r = &x->next;
+    }
+    else if ((x->start < start) && (x->end > end))
+    {
+      // removing the middle splits a region in two
+      vm_region_t *y = slab_alloc(&region_cache);
+
+      if (y == NULL)
+      {
+        return false;
+      }
+
+      y->start = end;
+      y->end = x->end;
+      y->fill = x->fill;
+      y->shm = x->shm;
+      y->offset = x->offset + (end - x->start);
+      y->next = x->next;
+      x->end = start;
+      x->next = y;
+
+      if (y->shm != NULL)
+      {
+        shm_get(y->shm);
+      }
+
+      break;
+    }
+    else if (x->start < start)
+    {
+      x->end = start;
+      r = &x->next;
+    }
+    else if (x->end > end)
+    {
+      x->offset += end - x->start;
+      x->start = end;
+      r = &x->next;
+    }
+    else
+    {
+      *r = x->next;
+
+      if (x->shm != NULL)
+      {
+        shm_put(x->shm);
+      }
+
+      slab_free(&region_cache, x);
+    }
+  }
+
+  // skip whole sections that have no second-level table, i.e., no pages
+  for (uint32_t va = start; va < end;)
+  {
+    if (vm_pte(as, va, false) == NULL)
+    {
+      va = (va + VM_SECTION_SIZE) & ~(VM_SECTION_SIZE - 1);
+      continue;
+    }
+
+    vm_unmap_page(as, va);
+    va += VM_PAGE_SIZE;
+  }
+
+  return true;
+}
+
+vm_region_t *vm_region_find(as_t *as, uint32_t va)
+{
+  for (vm_region_t *r = as->regions; (r != NULL) && (r->start <= va); r = r->next)
+  {
+    if (va < r->end)
+    {
+      return r;
+    }
+  }
+
+  return NULL;
+}
+
+/* The kernel accesses user memory (e.g., the buffer of a read or write)
+ * directly, via the address space of the executing process, so any fault
+ * that vm_fault can resolve is fine; but one it cannot would be taken in
+ * a kernel mode, and so halt the kernel.  A range is therefore only valid
+ * if every page in it is either mapped (in some form vm_fault deals with,
+ * e.g., copy-on-write or swapped out) or in a region to commit on demand.
+ * User programs are linked into the kernel image, though, so their text
+ * and read-only data (e.g., string literals) live there: a range in the
+ * image is also valid, but only as a source, since the kernel would
+ * otherwise write its own memory on behalf of the process.
+ */
+
+bool vm_user(as_t *as, uint32_t x, uint32_t n, bool write)
+{
+  uint32_t end = (uint32_t)(&image_end);
+
+  if (!write && (x >= RAM_BASE) && (x < end) && (n <= (end - x)))
+  {
+    return true;
+  }
+  if ((as == NULL) || (x < USER_BASE) || (x >= USER_LIMIT) || (n > (USER_LIMIT - x)))
+  {
+    return (n == 0);
+  }
+
+  for (uint32_t va = x & ~(VM_PAGE_SIZE - 1); va < (x + n); va += VM_PAGE_SIZE)
+  {
+    vm_region_t *r = vm_region_find(as, va);
+    uint32_t *pte = vm_pte(as, va, false);
+
+    if (r != NULL)
+    {
+      va = r->end - VM_PAGE_SIZE; // i.e., skip the rest of the region
+    }
+    else if ((pte == NULL) || (*pte == 0))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool vm_region_copy(as_t *dst, as_t *src)
+{
+  for (vm_region_t *r = src->regions; r != NULL; r = r->next)
+  {
+    if (!vm_region_insert(dst, r->start, r->end, r->fill, r->shm, r->offset, false))
+    {
+      return false;
+    }
+  }
+
+  dst->brk = src->brk;
+
+  return true;
+}
+
+uint32_t vm_region_gap(as_t *as, uint32_t lo, uint32_t hi, uint32_t n)
+{
+  if ((n == 0) || (n > (hi - lo)))
+  {
+    return 0;
+  }
+
+  uint32_t va = lo;
+
+  for (vm_region_t *r = as->regions; (r != NULL) && (r->start < hi); r = r->next)
+  {
+    if (r->end <= va)
+    {
+      continue;
+    }
+    if (r->start >= (va + n))
+    {
+      break;
+    }
+
+    va = r->end;
+  }
+
+  return ((va + n) <= hi) ? va : 0;
+}
+
+bool vm_brk(as_t *as, uint32_t x)
+{
+  if ((x < USER_HEAP_BASE) || (x > USER_MMAP_BASE))
+  {
+    return false;
+  }
+
+  uint32_t a = (as->brk + VM_PAGE_SIZE - 1) & ~(VM_PAGE_SIZE - 1);
+  uint32_t b = (x + VM_PAGE_SIZE - 1) & ~(VM_PAGE_SIZE - 1);
+
+  if ((b > a) && !vm_region_add(as, a, b, 0, true))
+  {
+    return false;
+  }
+  if ((b < a) && !vm_region_remove(as, b, a))
+  {
+    return false;
+  }
+
+  as->brk = x;
+
+  return true;
+}
+
+bool vm_as_share(as_t *dst, as_t *src)
+{
+  for (uint32_t i = USER_BASE >> VM_SECTION_SHIFT; i < USER_LIMIT >> VM_SECTION_SHIFT; i++)
+  {
+    if ((src->l1[i] & 0x3) != PTE_L1_COARSE)
+    {
+      continue;
+    }
+
+    uint32_t *l2 = (uint32_t *)(src->l1[i] & ~0x3FF);
+
+    for (int j = 0; j < VM_L2_ENTRIES; j++)
+    {
+      uint32_t va = (i << VM_SECTION_SHIFT) | (j << VM_PAGE_SHIFT);
+      uint32_t pa = l2[j] & ~(VM_PAGE_SIZE - 1);
+
+      if ((l2[j] == 0) || (PTE_L2_FRAME(l2[j]) && !page_managed(pa)))
+      {
+        continue;
+      }
+
+      // shared memory stays shared: dst maps it on demand, via its own region
+      vm_region_t *r = vm_region_find(src, va);
+
+      if ((r != NULL) && (r->shm != NULL))
+      {
+        continue;
+      }
+
+      uint32_t *pte = vm_pte(dst, va, true);
+
+      if (pte == NULL)
+      {
+        return false;
+      }
+      if (*pte != 0)
+      {
+        continue;
+      }
+
+      // a swapped page shares its slot, and is read back by each separately
+      if (PTE_L2_SWAPPED(l2[j]))
+      {
+        swap_get(PTE_L2_SLOT(l2[j]));
+        vm_set_pte(dst, pte, va, l2[j]);
+        continue;
+      }
+
+      // an aged page is shared as is, i.e., becomes valid again in both
+      uint32_t a = (l2[j] & (VM_PAGE_SIZE - 1)) | PTE_L2_SMALL | PTE_L2_XN | PTE_L2_APX;
+
+      if (l2[j] != (pa | a))
+      {
+        vm_set_pte(src, &l2[j], va, pa | a);
+      }
+
+      page_get(pa);
+      vm_set_pte(dst, pte, va, pa | a);
+    }
+  }
+
+  return true;
+}
+
+bool vm_as_exec(as_t *as)
+{
+  if (!vm_region_remove(as, USER_BASE, USER_LIMIT))
+  {
+    return false;
+  }
+
+  as->brk = USER_HEAP_BASE;
+
+  if ((uint32_t)(&user_bss_end) > (uint32_t)(&user_data_end))
+  {
+    if (!vm_region_add(as, (uint32_t)(&user_data_end), (uint32_t)(&user_bss_end), 0, false))
+    {
+      return false;
+    }
+  }
+
+  return vm_as_share(as, vm_image);
+}
+
+uint32_t vm_page_lend(as_t *as, uint32_t va)
+{
+  if ((va & (VM_PAGE_SIZE - 1)) || (va < USER_BASE) || (va >= USER_LIMIT))
+  {
+    return 0;
+  }
+
+  vm_region_t *r = vm_region_find(as, va);
+  uint32_t *pte = vm_pte(as, va, false);
+
+  if (((r != NULL) && (r->shm != NULL)) || (pte == NULL) || !PTE_L2_FRAME(*pte))
+  {
+    return 0;
+  }
+
+  uint32_t pa = *pte & ~(VM_PAGE_SIZE - 1);
+
+  if (!page_managed(pa))
+  {
+    return 0;
+  }
+
+  // as for fork, an aged page simply becomes valid again
+  uint32_t a = (*pte & (VM_PAGE_SIZE - 1)) | PTE_L2_SMALL | PTE_L2_XN | PTE_L2_APX;
+
+  if (*pte != (pa | a))
+  {
+    vm_set_pte(as, pte, va, pa | a);
+  }
+
+  page_get(pa);
+
+  return pa;
+}
+
+bool vm_page_flip(as_t *as, uint32_t va, uint32_t pa)
+{
+  if ((va & (VM_PAGE_SIZE - 1)) || (va < USER_BASE) || (va >= USER_LIMIT))
+  {
+    return false;
+  }
+
+  // the page must be private, and either in a region or already mapped
+  vm_region_t *r = vm_region_find(as, va);
+
+  if (r == NULL)
+  {
+    uint32_t *pte = vm_pte(as, va, false);
+
+    if ((pte == NULL) || !PTE_L2_FRAME(*pte))
+    {
+      return false;
+    }
+  }
+  else if (r->shm != NULL)
+  {
+    return false;
+  }
+
+  return vm_map_page(as, va, pa, PAGE_USER_RO);
+}
+
+// map the pages of the disk-backed region r that shm_frame read ahead of
+// the one at va, so a sequential scan does not fault on each of them
+void vm_fault_ahead(as_t *as, vm_region_t *r, uint32_t va)
+{
+  shm_t *shm = r->shm;
+
+  va &= ~(VM_PAGE_SIZE - 1);
+
+  for (uint32_t k = 1; (k <= SHM_AHEAD) && ((va + (k * VM_PAGE_SIZE)) < r->end); k++)
+  {
+    uint32_t x = va + (k * VM_PAGE_SIZE);
+    uint32_t i = (r->offset + (x - r->start)) >> VM_PAGE_SHIFT;
+    uint32_t *pte = vm_pte(as, x, false);
+
+    if ((shm->frames[i] == 0) || ((pte != NULL) && (*pte != 0)))
+    {
+      break;
+    }
+
+    uint32_t pa = shm->frames[i] & ~(VM_PAGE_SIZE - 1);
+
+    page_get(pa);
+
+    if (!vm_map_page(as, x, pa, shm_clean(shm, i) ? PAGE_USER_RO : PAGE_USER))
+    {
+      page_put(pa);
+      break;
+    }
+
+    shm->last = i; // so the fault after these still counts as sequential
+  }
+}
+
+int vm_fault(as_t *as, uint32_t va, uint32_t fsr)
+{
+  if ((as == NULL) || (va < USER_BASE) || (va >= USER_LIMIT))
+  {
+    return VM_FAULT_NONE;
+  }
+
+  uint32_t status = FSR_STATUS(fsr);
+
+  // an access to an aged page marks it referenced, and to a swapped one reads it back
+  if (status == FSR_TRANS_PAGE)
+  {
+    uint32_t *pte = vm_pte(as, va, false);
+
+    if ((pte != NULL) && PTE_L2_AGED(*pte))
+    {
+      vm_set_pte(as, pte, va, *pte | PTE_L2_SMALL | PTE_L2_XN);
+      return VM_FAULT_MINOR;
+    }
+    if ((pte != NULL) && PTE_L2_SWAPPED(*pte))
+    {
+      return swap_in(as, pte, va) ? VM_FAULT_SWAP : VM_FAULT_NONE;
+    }
+  }
+
+  // a first access to a page in some region commits it
+  if ((status == FSR_TRANS_SECTION) || (status == FSR_TRANS_PAGE))
+  {
+    vm_region_t *r = vm_region_find(as, va);
+
+    if (r == NULL)
+    {
+      return VM_FAULT_NONE;
+    }
+
+    uint32_t pa;
+    uint32_t a = PAGE_USER;
+
+    if (r->shm != NULL)
+    {
+      uint32_t i = (r->offset + (va - r->start)) >> VM_PAGE_SHIFT;
+
+      pa = shm_frame(r->shm, i);
+
+      if (pa == 0)
+      {
+        return VM_FAULT_NONE;
+      }
+
+      page_get(pa); // the mapping owns a reference, as well as the object
+
+      // a clean page read from the disk is read-only, until written to
+      if (shm_clean(r->shm, i))
+      {
+        a = PAGE_USER_RO;
+      }
+    }
+    else
+    {
+      pa = vm_frame_alloc();
+
+      if (pa == 0)
+      {
+        return VM_FAULT_NONE;
+      }
+
+      for (uint32_t i = 0; i < (VM_PAGE_SIZE / sizeof(uint32_t)); i++)
+      {
+        ((uint32_t *)(pa))[i] = r->fill;
+      }
+    }
+
+    if (!vm_map_page(as, va, pa, a))
+    {
+      page_put(pa);
+      return VM_FAULT_NONE;
+    }
+
+    if ((r->shm != NULL) && (r->shm->block != SHM_NONE))
+    {
+      vm_fault_ahead(as, r, va);
+    }
+
+    return VM_FAULT_DEMAND;
+  }
+
+  if (!(fsr & FSR_WNR) || (status != FSR_PERM_PAGE))
+  {
+    return VM_FAULT_NONE;
+  }
+
+  uint32_t *pte = vm_pte(as, va, false);
+
+  if ((pte == NULL) || !(*pte & PTE_L2_APX))
+  {
+    return VM_FAULT_NONE;
+  }
+
+  // a read-only shared page is a clean one from the disk, which is now dirty
+  vm_region_t *r = vm_region_find(as, va);
+
+  if ((r != NULL) && (r->shm != NULL))
+  {
+    shm_dirty(r->shm, (r->offset + (va - r->start)) >> VM_PAGE_SHIFT);
+    vm_set_pte(as, pte, va, *pte & ~PTE_L2_APX);
+    return VM_FAULT_MINOR;
+  }
+
+  uint32_t pa = *pte & ~(VM_PAGE_SIZE - 1);
+  uint32_t a = *pte & (VM_PAGE_SIZE - 1) & ~PTE_L2_APX;
+
+  // the last reference can simply be made writable, rather than copied
+  if (page_refs(pa) == 1)
+  {
+    vm_set_pte(as, pte, va, pa | a);
+    return VM_FAULT_COW;
+  }
+
+  uint32_t copy = vm_frame_alloc();
+
+  if (copy == 0)
+  {
+    return VM_FAULT_NONE;
+  }
+
+  memcpy((void *)(copy), (void *)(pa), VM_PAGE_SIZE);
+  vm_map_page(as, va, copy, a); // drops the reference to pa
+
+  return VM_FAULT_COW;
+}
+
+/* TTBR0 and CONTEXTIDR cannot be updated atomically, so the switch goes
+ * via the kernel page table: while it is in use, a walk can only produce
+ * global entries, so no entry is ever tagged with the wrong ASID.
+ */
+
+void vm_switch(as_t *as)
+{
+  if ((as == vm_current) && ((as == NULL) || ((as->asid & ~ASID_MASK) == vm_asid_generation)))
+  {
+    return;
+  }
+
+  mmu_set_ptr0(vm_kernel_pt);
+
+  if (as == NULL)
+  {
+    mmu_set_asid(0);
+    vm_current = NULL;
+    return;
+  }
+
+  if ((as->asid & ~ASID_MASK) != vm_asid_generation)
+  {
+    if (vm_asid_next > ASID_MASK)
+    {
+      vm_asid_generation += 1 << ASID_BITS;
+      vm_asid_next = 1;
+      mmu_flush();
+    }
+
+    as->asid = vm_asid_generation | vm_asid_next++;
+  }
+
+  mmu_set_asid(as->asid & ASID_MASK);
+  mmu_set_ptr0(as->l1);
+
+  if (VM_FLUSH)
+  {
+    mmu_flush();
+  }
+
+  vm_current = as;
+}
@@ -0,0 +1,280 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __VM_H
+#define __VM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "MMU.h"
+
+/* The first-level page table uses 1MB sections (see Section B3.5.1 of the
+ * ARMv7-A architecture reference manual) to identity map
+ *
+ * - RAM (including the alias at 0x00000000, which holds the vector table)
+ *   as normal, write-back, write-allocate cacheable memory, and
+ * - the device regions (i.e., 0x10000000...0x1FFFFFFF, which includes the
+ *   UARTs, timers and GIC) as strongly-ordered, execute-never memory,
+ *
+ * leaving everything else unmapped (bar the page kdata.h describes); using
+ * sections keeps TLB pressure low, since a single entry covers 1MB.  All
+ * mappings use domain 0, which is configured as a client (so the AP bits
+ * are checked).  User programs are linked into the kernel image, so RAM is
+ * read/write at PL0 too: any process can write to kernel memory.
+ *
+ * VM_CACHES can be set to 0 to enable the MMU but leave caches disabled,
+ * e.g., to compare performance with and without them: membench (memory
+ * bandwidth) and ctxbench (context switches) give the before and after.
+ */
+
+#define VM_CACHES         ( 1 )
+
+#define VM_SECTION_SIZE   ( 0x00100000 )
+#define VM_SECTION_SHIFT  ( 20 )
+#define VM_L1_ENTRIES     ( 4096 )
+
+#define RAM_BASE          ( 0x70000000 )
+#define RAM_SIZE          ( 0x20000000 )
+#define RAM_ALIAS_BASE    ( 0x00000000 )
+#define RAM_ALIAS_SIZE    ( 0x00100000 )
+#define DEV_BASE          ( 0x10000000 )
+#define DEV_SIZE          ( 0x10000000 )
+
+#define PTE_SECTION       ( 0x00000002 )
+#define PTE_B             ( 1 <<  2 )
+#define PTE_C             ( 1 <<  3 )
+#define PTE_XN            ( 1 <<  4 )
+#define PTE_DOMAIN( x )   ( ( x ) <<  5 )
+#define PTE_AP( x )       ( ( x ) << 10 )
+#define PTE_TEX( x )      ( ( x ) << 12 )
+#define PTE_NG            ( 1 << 17 )
+
+#define PTE_AP_RW         ( 0x3 ) // read/write at PL0 and PL1
+
+// normal memory: outer and inner write-back, write-allocate
+#define SECTION_NORMAL    ( PTE_SECTION | PTE_TEX( 1 ) | PTE_C | PTE_B | PTE_AP( PTE_AP_RW ) | PTE_DOMAIN( 0 ) )
+// strongly-ordered memory: never cached or buffered, never executed
+#define SECTION_DEVICE    ( PTE_SECTION | PTE_XN | PTE_AP( PTE_AP_RW ) | PTE_DOMAIN( 0 ) )
+
+/* Each process has its own address space, i.e., a first-level page table
+ * that starts as a copy of the kernel one: the kernel (and the user
+ * program image) remain mapped by global sections, whereas the user
+ * region USER_BASE...USER_LIMIT is mapped using 4KB small pages in
+ * coarse second-level tables (see Section B3.5.1 again) marked nG.
+ *
+ * Non-global TLB entries are tagged with the ASID in CONTEXTIDR, so there
+ * is no need to flush the TLB on a context switch.  ASIDs are allocated
+ * lazily from a counter, and tagged with a generation: once all 255 are
+ * exhausted, the generation is incremented and the TLB flushed, after
+ * which each address space is given a fresh ASID the next time it is
+ * switched to.  ASID 0 is reserved, i.e., used by kernel threads (which
+ * use the kernel page table, so only ever see global mappings).
+ *
+ * VM_FLUSH can be set to 1 to flush the TLB on every switch between
+ * address spaces anyway, i.e., as if there were no ASIDs, e.g., to measure
+ * what they save (see user/ctxbench.c).
+ */
+
+#define VM_FLUSH          ( 0 )
+
+#define VM_PAGE_SIZE      ( 0x00001000 )
+#define VM_PAGE_SHIFT     ( 12 )
+#define VM_L2_ENTRIES     ( 256 )
+#define VM_L1_ORDER       ( 2 ) // i.e., 16KB, per the alignment TTBR0 needs
+#define VM_L2_GROUP       ( 4 ) // second-level tables per page
+
+#define USER_BASE         ( 0x40000000 )
+#define USER_LIMIT        ( 0x60000000 )
+#define USER_HEAP_BASE    ( 0x48000000 ) // heap, grown by sbrk up to USER_MMAP_BASE
+#define USER_MMAP_BASE    ( 0x50000000 ) // anonymous mappings, placed first-fit
+#define USER_MMAP_LIMIT   ( 0x5F000000 ) // leaves room for the largest stack
+#define USER_STACK_TOP    ( USER_LIMIT )
+
+#define ASID_BITS         ( 8 )
+#define ASID_MASK         ( ( 1 << ASID_BITS ) - 1 )
+
+#define PTE_L1_COARSE     ( 0x00000001 )
+
+#define PTE_L2_SMALL      ( 0x00000002 )
+#define PTE_L2_XN         ( 1 <<  0 )
+#define PTE_L2_B          ( 1 <<  2 )
+#define PTE_L2_C          ( 1 <<  3 )
+#define PTE_L2_AP( x )    ( ( x ) <<  4 )
+#define PTE_L2_TEX( x )   ( ( x ) <<  6 )
+#define PTE_L2_APX        ( 1 <<  9 )
+#define PTE_L2_S          ( 1 << 10 )
+#define PTE_L2_NG         ( 1 << 11 )
+
+// normal, non-global memory: read/write at PL0 and PL1, never executed
+#define PAGE_USER         ( PTE_L2_SMALL | PTE_L2_XN | PTE_L2_TEX( 1 ) | PTE_L2_C | PTE_L2_B | PTE_L2_AP( PTE_AP_RW ) | PTE_L2_NG )
+// as above, but read-only at PL0 *and* PL1 (so kernel writes fault too)
+#define PAGE_USER_RO      ( PAGE_USER | PTE_L2_APX )
+
+/* Page tables, and the user pages they map, are backed by frames from the
+ * page allocator.  A second-level table is only 1KB, so each page holds
+ * VM_L2_GROUP of them, for VM_L2_GROUP adjacent 1MB sections.  Frames are
+ * reference counted: a page mapped by n address spaces has n references,
+ * and each mapping owns one of them.
+ *
+ * Fork shares every page of the parent with the child, read-only in both:
+ * a write then raises a permission fault, which vm_fault resolves by
+ * copying the frame (or, if the faulting address space is now the only
+ * one referring to it, simply making the page writable again).  Since
+ * private user pages are otherwise always writable, a read-only private
+ * page is always a copy-on-write one.
+ *
+ * A pipe uses the same mechanism to move whole pages from writer to
+ * reader without copying them: vm_page_lend makes a page of the writer
+ * copy-on-write and takes a reference to the frame, which vm_page_flip
+ * later maps (read-only) in place of a page of the reader.
+ *
+ * The user program data and bss segments are linked at USER_BASE (see
+ * image.ld): vm_image is an address space, never executed, which holds a
+ * pristine copy of the data, so exec can share it copy-on-write as well.
+ *
+ * Memory is otherwise committed on demand: an address space has a list of
+ * regions (e.g., the bss and the stack) that are reserved but unmapped, so
+ * the first access to a page in one raises a translation fault.  vm_fault
+ * then allocates a frame, fills it (with zero, or the region fill value;
+ * a stack uses this for painting), and maps it, so the access can simply
+ * be retried.  A process therefore only uses memory for pages it touches,
+ * and a stack can grow down to the bottom of its region; any access
+ * outside a region is left to the caller to deal with.  The heap is one
+ * more region, from USER_HEAP_BASE up to the break (rounded up to a page),
+ * and each anonymous mapping another, so both are committed on demand,
+ * and shrinking or unmapping them hands the frames straight back.  Growing
+ * the heap extends its region, so repeated sbrk calls do not make the list
+ * any longer; every other region (e.g., each mmap) is kept separate, even
+ * from an adjacent one with the same fill.
+ *
+ * A region may instead map a shared memory object (see shm.h), in which
+ * case a fault maps the frame the object holds for that page (committing
+ * it first, iff. need be), writable in every address space; only a clean
+ * page of an object backed by the disk is mapped read-only, so a write
+ * faults and marks it dirty.  Fork gives the child its own reference to
+ * the object, rather than sharing those pages copy-on-write, so they
+ * remain shared after it.
+ */
+
+#define FSR_STATUS( x )   ( ( ( x ) & 0xF ) | ( ( ( x ) >> 6 ) & 0x10 ) )
+#define FSR_WNR           ( 1 << 11 )
+#define FSR_TRANS_SECTION ( 0x05 )
+#define FSR_TRANS_PAGE    ( 0x07 )
+#define FSR_PERM_PAGE     ( 0x0F )
+
+#define VM_FAULT_NONE     ( 0 ) // i.e., not resolved
+#define VM_FAULT_COW      ( 1 ) // resolved by copying (or reclaiming) a shared page
+#define VM_FAULT_DEMAND   ( 2 ) // resolved by committing a page in a region
+#define VM_FAULT_MINOR    ( 3 ) // resolved by marking a page referenced, or dirty
+#define VM_FAULT_SWAP     ( 4 ) // resolved by reading a page back from swap
+#define VM_FAULT_TYPES    ( 5 )
+
+/* An invalid (i.e., faulting) user entry is either unused (i.e., 0), aged
+ * or swapped.  An aged entry is a page entry with bits 1...0 cleared, so
+ * it still owns its frame, but the next access faults and so marks it
+ * referenced again (see swap.h).  A swapped entry holds the swap slot,
+ * plus one, in place of a frame address, and no attributes: since every
+ * user page has attributes, the two cannot be confused.
+ */
+
+#define PTE_L2_VALID( x )   ( ( ( x ) & 0x3 ) != 0 )
+#define PTE_L2_AGED( x )    ( !PTE_L2_VALID( x ) && ( ( ( x ) & 0xFFC ) != 0 ) )
+#define PTE_L2_SWAPPED( x ) ( ( ( x ) != 0 ) && ( ( ( x ) & 0xFFF ) == 0 ) )
+#define PTE_L2_FRAME( x )   ( PTE_L2_VALID( x ) || PTE_L2_AGED( x ) ) // i.e., owns a frame
+#define PTE_L2_SLOT( x )    ( ( ( x ) >> VM_PAGE_SHIFT ) - 1 )
+#define PTE_L2_SWAP( s )    ( ( ( s ) + 1 ) << VM_PAGE_SHIFT )
+
+struct shm;
+
+typedef struct vm_region
+{
+  uint32_t start;         // first address (page aligned)
+  uint32_t end;           // first address beyond the region (page aligned)
+  uint32_t fill;          // written to every word of a page when committed
+  struct shm *shm;        // shared memory object mapped, or NULL if private
+  uint32_t offset;        // offset of start into shm, in bytes
+  struct vm_region *next; // next region, in address order
+} vm_region_t;
+
+typedef struct
+{
+  uint32_t *l1;         // first-level page table
+  uint32_t asid;        // ASID, plus generation in bits 31...8 (0 if never assigned)
+  vm_region_t *regions; // regions committed on demand
+  uint32_t brk;         // heap break, i.e., [USER_HEAP_BASE, brk) is usable
+  uint32_t clock;       // address the swap clock hand reached, when last scanned
+  uint32_t refs;        // processes sharing the address space, i.e., threads
+} as_t;
+
+extern uint32_t vm_kernel_pt[VM_L1_ENTRIES];
+extern as_t *vm_current;
+extern as_t *vm_image;
+
+// map n bytes from address x (both section aligned) using attributes a
+extern void vm_map_sections(uint32_t *pt, uint32_t x, uint32_t n, uint32_t a);
+// build the kernel page table, then enable the MMU and caches
+extern void vm_init();
+// build vm_image, once the page allocator is initialised
+extern void vm_image_init();
+
+// allocate an address space with only the kernel mapped, or return NULL
+extern as_t *vm_as_create();
+// deallocate an address space, plus any second-level tables it uses
+extern void vm_as_destroy(as_t *as);
+// take a reference to as
+extern void vm_as_get(as_t *as);
+// drop a reference to as, destroying it when the last one is dropped
+extern void vm_as_put(as_t *as);
+// return the second-level entry for va, allocating a table iff. alloc
+extern uint32_t *vm_pte(as_t *as, uint32_t va, bool alloc);
+// allocate a frame for a user page, swapping out others iff. need be, or return 0
+extern uint32_t vm_frame_alloc();
+// drop whatever the (removed) entry x owns, i.e., a frame or a swap slot
+extern void vm_pte_release(uint32_t x);
+// write x into the entry pte for va, then make the change visible to the MMU
+extern void vm_set_pte(as_t *as, uint32_t *pte, uint32_t va, uint32_t x);
+// map the page at va onto the frame at pa using attributes a
+extern bool vm_map_page(as_t *as, uint32_t va, uint32_t pa, uint32_t a);
+// unmap the page at va, if mapped, dropping the reference to its frame
+extern void vm_unmap_page(as_t *as, uint32_t va);
+
+// count the user pages mapped, i.e., committed, in an address space
+extern uint32_t vm_resident(as_t *as);
+
+// reserve [start, end) for commit on demand, unless it overlaps a region, extending an adjacent one iff. merge
+extern bool vm_region_add(as_t *as, uint32_t start, uint32_t end, uint32_t fill, bool merge);
+// as above, but map shm from offset x, taking a reference to it
+extern bool vm_region_map(as_t *as, uint32_t start, uint32_t end, struct shm *shm, uint32_t x);
+// unmap [start, end), and remove it from any region it overlaps
+extern bool vm_region_remove(as_t *as, uint32_t start, uint32_t end);
+// return the region containing va, or NULL if there is none
+extern vm_region_t *vm_region_find(as_t *as, uint32_t va);
+// return true iff. the kernel can access n bytes from x in as (and write them iff. write), i.e., each page is mapped or in a region
+extern bool vm_user(as_t *as, uint32_t x, uint32_t n, bool write);
+// give dst a copy of every region src has (and the same heap break)
+extern bool vm_region_copy(as_t *dst, as_t *src);
+// return the lowest address in [lo, hi) with n bytes in no region, or 0 if there is none
+extern uint32_t vm_region_gap(as_t *as, uint32_t lo, uint32_t hi, uint32_t n);
+// move the heap break to x, reserving or unmapping pages to match
+extern bool vm_brk(as_t *as, uint32_t x);
+
+// share every user page src maps (but dst does not) copy-on-write
+extern bool vm_as_share(as_t *dst, as_t *src);
+// replace every user page and region in as with the pristine program data and bss
+extern bool vm_as_exec(as_t *as);
+// make the private page at va copy-on-write, and return its frame with a reference taken (or 0 if it cannot be)
+extern uint32_t vm_page_lend(as_t *as, uint32_t va);
+// map frame pa at va copy-on-write in place of whatever was there, passing on a reference to it
+extern bool vm_page_flip(as_t *as, uint32_t va, uint32_t pa);
+// resolve a fault at va with status fsr, returning the VM_FAULT_* type
+extern int vm_fault(as_t *as, uint32_t va, uint32_t fsr);
+// switch to an address space (or to the kernel page table iff. as is NULL)
+extern void vm_switch(as_t *as);
+
+#endif
@@ -0,0 +1,129 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+work_queue_t softirq_queue = {NULL, NULL};
+work_queue_t kworker_queue = {NULL, NULL};
+
+pcb_t *kworker = NULL;
+
+void work_init(work_t *w, void (*fn)(void *), void *arg)
+{
+  w->fn = fn;
+  w->arg = arg;
+  w->queued = false;
+  w->next = NULL;
+}
+
+bool work_queue(work_queue_t *q, work_t *w)
+{
+  if (w->queued)
+  {
+    return false;
+  }
+
+  w->queued = true;
+  w->next = NULL;
+
+  if (q->tail == NULL)
+  {
+    q->head = w;
+  }
+  else
+  {
+    q->tail->next = w;
+  }
+  q->tail = w;
+
+  return true;
+}
+
+work_t *work_dequeue(work_queue_t *q)
+{
+  work_t *w = q->head;
+
+  if (w != NULL)
+  {
+    q->head = w->next;
+    if (q->head == NULL)
+    {
+      q->tail = NULL;
+    }
+    w->queued = false;
+  }
+
+  return w;
+}
+
+bool work_pending(work_queue_t *q)
+{
+  return q->head != NULL;
+}
+
+void work_run(work_queue_t *q)
+{
+  while (true)
+  {
+    // a top half may queue work at any point, so only the dequeue itself
+    // needs to happen with IRQs disabled
+    int_unable_irq();
+    work_t *w = work_dequeue(q);
+    int_enable_irq();
+
+    if (w == NULL)
+    {
+      break;
+    }
+
+    w->fn(w->arg);
+  }
+}
+
+/* Interrupt handlers may be preempted by higher priority ones, so raising
+ * work disables IRQ interrupts around the queue update.
+ */
+
+void softirq_raise(work_t *w)
+{
+  uint32_t cpsr = int_save_irq();
+  work_queue(&softirq_queue, w);
+  int_restore_irq(cpsr);
+}
+
+void kworker_schedule(work_t *w)
+{
+  uint32_t cpsr = int_save_irq();
+  if (work_queue(&kworker_queue, w) && (kworker != NULL) && (kworker->status == STATUS_WAITING))
+  {
+    kworker->status = STATUS_READY;
+    need_resched = true;
+  }
+  int_restore_irq(cpsr);
+}
+
+/* The worker thread executes in SYS mode, so shares the kernel image but
+ * is preempted and scheduled exactly like a user process.  It checks for
+ * work and, if there is none, marks itself waiting with IRQs disabled so
+ * a wakeup from kworker_schedule cannot be lost in between.
+ */
+
+void kworker_main()
+{
+  while (true)
+  {
+    int_unable_irq();
+    if (!work_pending(&kworker_queue))
+    {
+      executing->status = STATUS_WAITING;
+      kthread_yield();
+    }
+    int_enable_irq();
+
+    work_run(&kworker_queue);
+  }
+}
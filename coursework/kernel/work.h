@@ -0,0 +1,67 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __WORK_H
+#define __WORK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Deferred work (i.e., bottom halves): interrupt handlers (top halves)
+ * only acknowledge their device and queue a work item, which is then
+ * executed later with interrupts enabled.  There are two queues:
+ *
+ * - softirq_queue, which is drained by the kernel just before it returns
+ *   to a USR (or kernel thread) context, and so suits short jobs such as
+ *   waking a blocked process, and
+ * - kworker_queue, which is drained by kernel worker threads; these are
+ *   scheduled like any other process, so can be used for heavier jobs
+ *   such as writeback.
+ *
+ * Work items are embedded in whatever structure owns them, so queueing
+ * never allocates and an item that is already queued is not queued twice.
+ */
+
+typedef struct work
+{
+  void (*fn)(void *); // function to execute
+  void *arg;          // argument passed to fn
+  bool queued;        // true iff. currently in a queue
+  struct work *next;  // next item in queue
+} work_t;
+
+typedef struct
+{
+  work_t *head;
+  work_t *tail;
+} work_queue_t;
+
+extern work_queue_t softirq_queue;
+extern work_queue_t kworker_queue;
+
+// initialise work item w st. it executes fn( arg )
+extern void work_init(work_t *w, void (*fn)(void *), void *arg);
+
+// append w to q, unless already queued: must be called with IRQs disabled
+extern bool work_queue(work_queue_t *q, work_t *w);
+// remove first item from q, or return NULL if empty
+extern work_t *work_dequeue(work_queue_t *q);
+// true iff. q is non-empty
+extern bool work_pending(work_queue_t *q);
+// execute items in q until it is empty, with IRQs enabled while each executes
+extern void work_run(work_queue_t *q);
+
+// queue w for execution on return to thread context
+extern void softirq_raise(work_t *w);
+// queue w for execution by a kernel worker thread
+extern void kworker_schedule(work_t *w);
+
+// body of a kernel worker thread
+extern void kworker_main();
+
+#endif
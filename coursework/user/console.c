@@ -38,6 +38,11 @@ extern void main_P3();
 extern void main_P4(); 
 extern void main_P5(); 
 extern void main_philosophers();
+extern void main_forkbench();
+extern void main_pipebench();
+extern void main_membench();
+extern void main_ringbench();
+extern void main_ctxbench();
 
 void* load( char* x ) {
   if     ( 0 == strcmp( x, "P3" ) ) {
@@ -52,6 +57,21 @@ void* load( char* x ) {
   else if( 0 == strcmp( x, "philosophers")) {
     return &main_philosophers;
   }
+  else if( 0 == strcmp( x, "forkbench" ) ) {
+    return &main_forkbench;
+  }
+  else if( 0 == strcmp( x, "pipebench" ) ) {
+    return &main_pipebench;
+  }
+  else if( 0 == strcmp( x, "membench" ) ) {
+    return &main_membench;
+  }
+  else if( 0 == strcmp( x, "ringbench" ) ) {
+    return &main_ringbench;
+  }
+  else if( 0 == strcmp( x, "ctxbench" ) ) {
+    return &main_ctxbench;
+  }
 
   return NULL;
 }
@@ -63,18 +83,25 @@ void* load( char* x ) {
  * 2. tokenize command, then
  * 3. execute command.
  *
+ * Since the console is also init, i.e., it inherits any orphaned process,
+ * each iteration also reaps whichever children have exited.
+ *
  * As is, the console only recognises the following commands:
  *
- * a. execute <program name>
+ * a. execute <program name> [stack size]
  *
- *    This command will use fork to create a new process; the parent
- *    (i.e., the console) will continue as normal, whereas the child
- *    uses exec to replace the process image and thereby execute a
- *    different (named) program.  For example,
+ *    This command will use spawn to create a new process, which starts
+ *    executing a different (named) program straight away, with a fresh
+ *    program image and stack; the console continues as normal.  For
+ *    example,
  *    
  *    execute P3
  *
- *    would execute the user program named P3.
+ *    would execute the user program named P3, and
+ *
+ *    execute P4 16384
+ *
+ *    would execute P4 with a 16KB (vs. default 64KB) stack.
  *
  * b. terminate <process ID> 
  *
@@ -86,12 +113,41 @@ void* load( char* x ) {
  *    terminate 3
  *
  *    would terminate the process whose PID is 3.
+ *
+ * c. meminfo
+ *
+ *    This command prints the number of free blocks of each order (i.e.,
+ *    of 2^order pages) the kernel page allocator has.
+ *
+ * d. slabinfo
+ *
+ *    This command prints, for each kernel object cache, the object size
+ *    then the number of objects in use, allocated in total and in use at
+ *    peak (which helps to spot leaks).
+ *
+ * e. stackinfo <process ID>
+ *
+ *    This command prints the stack size of a specific process, then the
+ *    most of it that process has used so far.
+ *
+ * f. faultinfo <process ID>
+ *
+ *    This command prints the number of copy-on-write, demand (i.e., first
+ *    touch), minor (i.e., referencing an aged page) and swap-in page faults
+ *    a specific process has taken so far, then the number of pages it has
+ *    resident.
  */
 
 void main_console() {
   while( 1 ) {
     char cmd[ MAX_CMD_CHARS ];
 
+    // step 0: reap any children that have exited.
+
+    while( waitpid( -1, NULL, WNOHANG ) > 0 ) {
+      continue;
+    }
+
     // step 1: write command prompt, then read command.
 
     puts( "console$ ", 10 ); gets( cmd, MAX_CMD_CHARS );
@@ -110,9 +166,9 @@ void main_console() {
       void* addr = load( cmd_argv[ 1 ] );
 
       if( addr != NULL ) {
-        if( 0 == fork() ) {
-          exec( addr );
-        }
+        spawn_attr_t attrs = { .stack = ( cmd_argc > 2 ) ? atoi( cmd_argv[ 2 ] ) : 0 };
+
+        spawn( addr, NULL, &attrs );
       }
       else {
         puts( "unknown program\n", 16 );
@@ -121,6 +177,57 @@ void main_console() {
     else if( 0 == strcmp( cmd_argv[ 0 ], "terminate" ) ) {
       kill( atoi( cmd_argv[ 1 ] ), SIG_TERM );
     } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "meminfo"   ) ) {
+      uint32_t x[ MAX_ORDERS ]; char r[ 12 ];
+
+      int n = meminfo( x, MAX_ORDERS );
+
+      for( int k = 0; ( k < n ) && ( k < MAX_ORDERS ); k++ ) {
+        itoa( r, k      ); puts( r, strlen( r ) ); puts( ": ", 2 );
+        itoa( r, x[ k ] ); puts( r, strlen( r ) ); puts( "\n", 1 );
+      }
+    }
+    else if( 0 == strcmp( cmd_argv[ 0 ], "stackinfo" ) ) {
+      uint32_t x[ 2 ]; char r[ 12 ];
+
+      if( 0 == stackinfo( atoi( cmd_argv[ 1 ] ), x ) ) {
+        itoa( r, x[ 0 ] ); puts( "size ", 5 ); puts( r, strlen( r ) );
+        itoa( r, x[ 1 ] ); puts( " used ", 6 ); puts( r, strlen( r ) );
+        puts( "\n", 1 );
+      }
+      else {
+        puts( "unknown process\n", 16 );
+      }
+    }
+    else if( 0 == strcmp( cmd_argv[ 0 ], "faultinfo" ) ) {
+      uint32_t x[ 5 ]; char r[ 12 ];
+
+      if( 0 == faultinfo( atoi( cmd_argv[ 1 ] ), x ) ) {
+        itoa( r, x[ 0 ] ); puts( "cow ", 4 ); puts( r, strlen( r ) );
+        itoa( r, x[ 1 ] ); puts( " demand ", 8 ); puts( r, strlen( r ) );
+        itoa( r, x[ 2 ] ); puts( " minor ", 7 ); puts( r, strlen( r ) );
+        itoa( r, x[ 3 ] ); puts( " swap ", 6 ); puts( r, strlen( r ) );
+        itoa( r, x[ 4 ] ); puts( " resident ", 10 ); puts( r, strlen( r ) );
+        puts( "\n", 1 );
+      }
+      else {
+        puts( "unknown process\n", 16 );
+      }
+    }
+    else if( 0 == strcmp( cmd_argv[ 0 ], "slabinfo"  ) ) {
+      slabinfo_t x[ MAX_CACHES ]; char r[ 12 ];
+
+      int n = slabinfo( x, MAX_CACHES );
+
+      for( int i = 0; ( i < n ) && ( i < MAX_CACHES ); i++ ) {
+        puts( x[ i ].name, strnlen( x[ i ].name, 8 ) );
+        itoa( r, x[ i ].size  ); puts( " size ",  6 ); puts( r, strlen( r ) );
+        itoa( r, x[ i ].used  ); puts( " used ",  6 ); puts( r, strlen( r ) );
+        itoa( r, x[ i ].total ); puts( " total ", 7 ); puts( r, strlen( r ) );
+        itoa( r, x[ i ].peak  ); puts( " peak ",  6 ); puts( r, strlen( r ) );
+        puts( "\n", 1 );
+      }
+    }
     else {
       puts( "unknown command\n", 16 );
     }
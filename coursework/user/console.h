@@ -19,6 +19,8 @@
 #include "libc.h"
 
 #define MAX_CMD_CHARS ( 1024 )
-#define MAX_CMD_ARGS  (    2 )
+#define MAX_CMD_ARGS  (    3 )
+#define MAX_ORDERS    (   16 )
+#define MAX_CACHES    (   16 )
 
 #endif
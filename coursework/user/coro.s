@@ -0,0 +1,26 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* A coroutine switch is a function call as far as the compiler is
+ * concerned, so per AAPCS it only has to preserve the callee-saved
+ * registers, i.e., r4-r11, sp and lr (there are no VFP registers to
+ * preserve, since everything is built for soft-float).  coro_switch
+ * stores those in the context x points at, loads them from the one y
+ * points at, then returns via the new lr: either into a coro_switch the
+ * other coroutine made earlier, or, for a new one, into coro_start (see
+ * coro_create).  Either way, it takes a dozen or so instructions and never
+ * enters the kernel.
+ */
+
+.global coro_switch
+
+coro_switch:         mov   r2, sp                  @ ARM deprecates SP in an LDM/STM register list
+                     stmia r0, { r4-r11, r2, lr }  @ preserve callee-saved registers in x
+                     ldmia r1, { r4-r11, r2, lr }  @ restore  callee-saved registers from y
+                     mov   sp, r2
+
+                     bx    lr                      @ return, i.e., resume y
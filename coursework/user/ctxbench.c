@@ -0,0 +1,95 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "ctxbench.h"
+
+/* This measures the time taken per round trip between a parent and a
+ * child that pass a byte back and forth through two pipes, so each round
+ * trip is two context switches between address spaces, with each side
+ * touching 0, 4, 16 and then CTXBENCH_PAGES pages of its own after every
+ * switch.  Each page it touches needs a TLB entry, so once the TLB is
+ * warm the time per round trip only grows with the pages touched iff.
+ * their entries do not survive a switch.  Building with VM_FLUSH = 0 then
+ * 1 (see kernel/vm.h) compares ASID-tagged entries with a TLB flushed on
+ * every switch, and with VM_CACHES = 1 then 0, cached with uncached.
+ *
+ * Times use the 24MHz counter, so are in units of ~42ns; a timer tick may
+ * land in any measurement, so repeat a run before trusting a difference.
+ */
+
+uint8_t ctxbench_pages[ CTXBENCH_PAGES * PAGE_SIZE ];
+
+volatile int ctxbench_sink; // i.e., so the loads are not discarded
+
+// touch one word in each of the first n pages
+void ctxbench_touch( int n ) {
+  for( int i = 0; i < n; i++ ) {
+    ctxbench_sink += ctxbench_pages[ i * PAGE_SIZE ];
+  }
+}
+
+// pass a byte over fds[ out ], then wait for it back on fds[ in ], touching n pages after each
+void ctxbench_pingpong( int in, int out, int n, bool first ) {
+  char x = 0;
+
+  for( int i = 0; i < CTXBENCH_ROUNDS; i++ ) {
+    if( first ) {
+      write( out, &x, 1 );
+    }
+
+    read( in, &x, 1 ); ctxbench_touch( n );
+
+    if( !first ) {
+      write( out, &x, 1 );
+    }
+  }
+}
+
+uint32_t ctxbench_run( int n ) {
+  int a[ 2 ], b[ 2 ];
+
+  if( ( pipe( a ) != 0 ) || ( pipe( b ) != 0 ) ) {
+    return 0;
+  }
+
+  pid_t pid = fork();
+
+  if( 0 == pid ) {
+    ctxbench_touch( n ); // i.e., commit and copy the pages first
+    ctxbench_pingpong( a[ 0 ], b[ 1 ], n, false );
+    exit( EXIT_SUCCESS );
+  }
+
+  uint32_t t0 = SYSCONF->COUNTER_24MHZ;
+
+  ctxbench_pingpong( b[ 0 ], a[ 1 ], n, true );
+
+  uint32_t t1 = SYSCONF->COUNTER_24MHZ;
+
+  waitpid( pid, NULL, 0 );
+
+  close( a[ 0 ] ); close( a[ 1 ] );
+  close( b[ 0 ] ); close( b[ 1 ] );
+
+  return t1 - t0;
+}
+
+void main_ctxbench() {
+  int sizes[] = { 0, 4, 16, CTXBENCH_PAGES };
+
+  memset( ctxbench_pages, 0xA5, sizeof( ctxbench_pages ) ); // i.e., commit the pages first
+
+  printf( "\n%8s %10s %10s\n", "pages", "total", "per trip" );
+
+  for( int k = 0; k < ( sizeof( sizes ) / sizeof( int ) ); k++ ) {
+    uint32_t t = ctxbench_run( sizes[ k ] );
+
+    printf( "%8d %10u %10u\n", sizes[ k ], t, t / CTXBENCH_ROUNDS );
+  }
+
+  exit( EXIT_SUCCESS );
+}
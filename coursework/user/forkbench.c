@@ -0,0 +1,61 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "forkbench.h"
+
+/* For a parent which has written to 0, 1, 4 and then 16 pages of ballast
+ * (i.e., has that many private pages on top of the program image), this
+ * measures
+ *
+ * - the latency of fork, i.e., until the parent resumes, and
+ * - the time the child then takes to write once to each of those pages,
+ *   each write being a copy-on-write fault,
+ *
+ * using the 24MHz counter, so each time is in units of ~42ns.
+ */
+
+uint8_t ballast[ BALLAST_PAGES * PAGE_SIZE ];
+
+void report( char* x, int n, uint32_t t ) {
+  char r[ 12 ];
+
+  write( STDOUT_FILENO, x, strlen( x ) );
+  itoa( r, n ); write( STDOUT_FILENO, r, strlen( r ) );
+  write( STDOUT_FILENO, " => ", 4 );
+  itoa( r, t ); write( STDOUT_FILENO, r, strlen( r ) );
+  write( STDOUT_FILENO, "\n", 1 );
+}
+
+void main_forkbench() {
+  int sizes[] = { 0, 1, 4, 16 };
+
+  for( int i = 0; i < 4; i++ ) {
+    int n = sizes[ i ];
+
+    for( int j = 0; j < n; j++ ) {
+      ballast[ j * PAGE_SIZE ] = j;
+    }
+
+    uint32_t t0 = SYSCONF->COUNTER_24MHZ;
+    pid_t pid = fork();
+    uint32_t t1 = SYSCONF->COUNTER_24MHZ;
+
+    if( 0 == pid ) {
+      for( int j = 0; j < n; j++ ) {
+        ballast[ j * PAGE_SIZE ] = ~j;
+      }
+
+      report( "\ncow  ", n, SYSCONF->COUNTER_24MHZ - t1 );
+      exit( EXIT_SUCCESS );
+    }
+
+    report( "\nfork ", n, t1 - t0 );
+    waitpid( pid, NULL, 0 );
+  }
+
+  exit( EXIT_SUCCESS );
+}
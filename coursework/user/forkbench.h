@@ -0,0 +1,24 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __FORKBENCH_H
+#define __FORKBENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "SYS.h"
+
+#include "libc.h"
+
+#define BALLAST_PAGES ( 16 )
+#define PAGE_SIZE     ( 0x1000 )
+
+#endif
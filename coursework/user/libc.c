@@ -7,6 +7,9 @@
 
 #include "libc.h"
 
+#include <stdarg.h>
+#include <string.h>
+
 int  atoi( char* x        ) {
   char* p = x; bool s = false; int r = 0;
 
@@ -79,6 +82,10 @@ int write( int fd, const void* x, size_t n ) {
 int  read( int fd,       void* x, size_t n ) {
   int r;
 
+  if( fd == STDIN_FILENO ) {
+    bflush( STDOUT_FILENO ); // e.g., so a prompt is visible before input
+  }
+
   asm volatile( "mov r0, %2 \n" // assign r0 = fd
                 "mov r1, %3 \n" // assign r1 =  x
                 "mov r2, %4 \n" // assign r2 =  n
@@ -91,9 +98,41 @@ int  read( int fd,       void* x, size_t n ) {
   return r;
 }
 
+int writev( int fd, const iovec_t* iov, int n ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  fd
+                "mov r1, %3 \n" // assign r1 = iov
+                "mov r2, %4 \n" // assign r2 =   n
+                "svc %1     \n" // make system call SYS_WRITEV
+                "mov %0, r0 \n" // assign r  =  r0
+              : "=r" (r) 
+              : "I" (SYS_WRITEV), "r" (fd), "r" (iov), "r" (n)
+              : "r0", "r1", "r2", "memory" );
+
+  return r;
+}
+
+int  readv( int fd, const iovec_t* iov, int n ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  fd
+                "mov r1, %3 \n" // assign r1 = iov
+                "mov r2, %4 \n" // assign r2 =   n
+                "svc %1     \n" // make system call SYS_READV
+                "mov %0, r0 \n" // assign r  =  r0
+              : "=r" (r) 
+              : "I" (SYS_READV), "r" (fd), "r" (iov), "r" (n)
+              : "r0", "r1", "r2", "memory" );
+
+  return r;
+}
+
 int  fork() {
   int r;
 
+  bflush( -1 ); // otherwise, the child would write whatever is buffered too
+
   asm volatile( "svc %1     \n" // make system call SYS_FORK
                 "mov %0, r0 \n" // assign r  = r0 
               : "=r" (r) 
@@ -104,6 +143,8 @@ int  fork() {
 }
 
 void exit( int x ) {
+  bflush( -1 );
+
   asm volatile( "mov r0, %1 \n" // assign r0 =  x
                 "svc %0     \n" // make system call SYS_EXIT
               :
@@ -114,15 +155,54 @@ void exit( int x ) {
 }
 
 void exec( const void* x ) {
+  exec_stack( x, 0 );
+
+  return;
+}
+
+void exec_stack( const void* x, size_t n ) {
+  bflush( -1 );
+
   asm volatile( "mov r0, %1 \n" // assign r0 = x
+                "mov r1, %2 \n" // assign r1 = n
                 "svc %0     \n" // make system call SYS_EXEC
               :
-              : "I" (SYS_EXEC), "r" (x)
-              : "r0" );
+              : "I" (SYS_EXEC), "r" (x), "r" (n)
+              : "r0", "r1" );
 
   return;
 }
 
+pid_t spawn( const void* x, const uint32_t* args, const spawn_attr_t* attrs ) {
+  pid_t r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =     x
+                "mov r1, %3 \n" // assign r1 =  args
+                "mov r2, %4 \n" // assign r2 = attrs
+                "svc %1     \n" // make system call SYS_SPAWN
+                "mov %0, r0 \n" // assign r  =    r0
+              : "=r" (r)
+              : "I" (SYS_SPAWN), "r" (x), "r" (args), "r" (attrs)
+              : "r0", "r1", "r2" );
+
+  return r;
+}
+
+int  spawnv( spawn_t* x, int n, const spawn_attr_t* attrs ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =     x
+                "mov r1, %3 \n" // assign r1 =     n
+                "mov r2, %4 \n" // assign r2 = attrs
+                "svc %1     \n" // make system call SYS_SPAWNV
+                "mov %0, r0 \n" // assign r  =    r0
+              : "=r" (r)
+              : "I" (SYS_SPAWNV), "r" (x), "r" (n), "r" (attrs)
+              : "r0", "r1", "r2", "memory" );
+
+  return r;
+}
+
 int  kill( int pid, int x ) {
   int r;
 
@@ -161,4 +241,904 @@ int  pipe( int fds[2] ) {
   return r;
 }
 
+int  close( int fd ) {
+  int r;
+
+  bflush( fd );
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =   fd
+                "svc %1     \n" // make system call SYS_CLOSE
+                "mov %0, r0 \n" // assign r  =   r0
+              : "=r" (r)
+              : "I" (SYS_CLOSE), "r" (fd)
+              : "r0" );
+
+  return r;
+}
+
+int  waitpid( pid_t pid, int* status, int options ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =     pid
+                "mov r1, %3 \n" // assign r1 =  status
+                "mov r2, %4 \n" // assign r2 = options
+                "svc %1     \n" // make system call SYS_WAITPID
+                "mov %0, r0 \n" // assign r  =      r0
+              : "=r" (r)
+              : "I" (SYS_WAITPID), "r" (pid), "r" (status), "r" (options)
+              : "r0", "r1", "r2", "memory" );
+
+  return r;
+}
+
+int  wait( int* status ) {
+  return waitpid( -1, status, 0 );
+}
+
+int  meminfo( uint32_t* x, int n ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  x
+                "mov r1, %3 \n" // assign r1 =  n
+                "svc %1     \n" // make system call SYS_MEMINFO
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MEMINFO), "r" (x), "r" (n)
+              : "r0", "r1", "memory" );
+
+  return r;
+}
+
+int  slabinfo( slabinfo_t* x, int n ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  x
+                "mov r1, %3 \n" // assign r1 =  n
+                "svc %1     \n" // make system call SYS_SLABINFO
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SLABINFO), "r" (x), "r" (n)
+              : "r0", "r1", "memory" );
+
+  return r;
+}
+
+int  stackinfo( pid_t pid, uint32_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = pid
+                "mov r1, %3 \n" // assign r1 =   x
+                "svc %1     \n" // make system call SYS_STACKINFO
+                "mov %0, r0 \n" // assign r  =  r0
+              : "=r" (r)
+              : "I" (SYS_STACKINFO), "r" (pid), "r" (x)
+              : "r0", "r1", "memory" );
+
+  return r;
+}
+
+int  faultinfo( pid_t pid, uint32_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = pid
+                "mov r1, %3 \n" // assign r1 =   x
+                "svc %1     \n" // make system call SYS_FAULTINFO
+                "mov %0, r0 \n" // assign r  =  r0
+              : "=r" (r)
+              : "I" (SYS_FAULTINFO), "r" (pid), "r" (x)
+              : "r0", "r1", "memory" );
+
+  return r;
+}
+
+void* sbrk( intptr_t n ) {
+  void* r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  n
+                "svc %1     \n" // make system call SYS_SBRK
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SBRK), "r" (n)
+              : "r0", "memory" );
+
+  return r;
+}
+
+void* mmap( size_t n ) {
+  void* r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  n
+                "svc %1     \n" // make system call SYS_MMAP
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MMAP), "r" (n)
+              : "r0", "memory" );
+
+  return r;
+}
+
+int  munmap( void* x, size_t n ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  x
+                "mov r1, %3 \n" // assign r1 =  n
+                "svc %1     \n" // make system call SYS_MUNMAP
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MUNMAP), "r" (x), "r" (n)
+              : "r0", "r1", "memory" );
+
+  return r;
+}
+
+void* shmmap( uint32_t x, size_t n ) {
+  void* r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  x
+                "mov r1, %3 \n" // assign r1 =  n
+                "svc %1     \n" // make system call SYS_SHMMAP
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SHMMAP), "r" (x), "r" (n)
+              : "r0", "r1" );
+
+  return r;
+}
+
+int  shmunmap( void* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  x
+                "svc %1     \n" // make system call SYS_SHMUNMAP
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SHMUNMAP), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+void* dmap( uint32_t a, size_t n ) {
+  void* r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  a
+                "mov r1, %3 \n" // assign r1 =  n
+                "svc %1     \n" // make system call SYS_DMAP
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_DMAP), "r" (a), "r" (n)
+              : "r0", "r1" );
+
+  return r;
+}
+
+int  msync( void* x, size_t n ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =  x
+                "mov r1, %3 \n" // assign r1 =  n
+                "svc %1     \n" // make system call SYS_MSYNC
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MSYNC), "r" (x), "r" (n)
+              : "r0", "r1" );
+
+  return r;
+}
+
+ring_t* ring_setup( uint32_t flags ) {
+  ring_t* r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = flags
+                "svc %1     \n" // make system call SYS_RING_SETUP
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_RING_SETUP), "r" (flags)
+              : "r0" );
+
+  return r;
+}
+
+int  ring_enter( uint32_t flags ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = flags
+                "svc %1     \n" // make system call SYS_RING_ENTER
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_RING_ENTER), "r" (flags)
+              : "r0", "memory" );
+
+  return r;
+}
+
+int  clone( void* entry, void* stack, uint32_t flags, void* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = entry
+                "mov r1, %3 \n" // assign r1 = stack
+                "mov r2, %4 \n" // assign r2 = flags
+                "mov r3, %5 \n" // assign r3 = x
+                "svc %1     \n" // make system call SYS_CLONE
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_CLONE), "r" (entry), "r" (stack), "r" (flags), "r" (x)
+              : "r0", "r1", "r2", "r3" );
+
+  return r;
+}
+
+/* Each process has its own arena, i.e., malloc_runs (which lives in the
+ * bss, so is private to the process and copied on fork): for each size
+ * class, it heads a list of runs with at least one free block.  So
+ * malloc is O(1), taking a block from the first run (either from the free
+ * list, or the untouched end of the run), and so is free, since masking
+ * the block address finds the run header.  Pages of a run are committed
+ * by the kernel as they are first touched, and a run that becomes empty
+ * is unmapped (unless it is the last of its class, to avoid thrashing),
+ * so memory goes back to the kernel a run at a time.
+ */
+
+run_t* malloc_runs[ MALLOC_CLASSES ];
+
+run_t* malloc_map( size_t n ) {
+  uint32_t x = ( uint32_t )( mmap( n ) );
+
+  if( ( x == 0 ) || !( x & ( MALLOC_RUN - 1 ) ) ) {
+    return ( run_t* )( x );
+  }
+
+  // map enough to hold an aligned block, then trim either side of it
+  size_t m = n + MALLOC_RUN - PAGE_SIZE;
+
+  munmap( ( void* )( x ), n );
+
+  if( 0 == ( x = ( uint32_t )( mmap( m ) ) ) ) {
+    return NULL;
+  }
+
+  uint32_t y = ( x + MALLOC_RUN - 1 ) & ~( MALLOC_RUN - 1 );
+
+  if( y > x ) {
+    munmap( ( void* )( x ), y - x );
+  }
+  if( ( y + n ) < ( x + m ) ) {
+    munmap( ( void* )( y + n ), ( x + m ) - ( y + n ) );
+  }
+
+  return ( run_t* )( y );
+}
+
+void* malloc( size_t n ) {
+  if( n == 0 ) {
+    return NULL;
+  }
+
+  if( n > MALLOC_MAX ) {
+    if( n > ( SIZE_MAX - MALLOC_HEADER - PAGE_SIZE ) ) {
+      return NULL;
+    }
+
+    size_t m = ( n + MALLOC_HEADER + PAGE_SIZE - 1 ) & ~( PAGE_SIZE - 1 );
+    run_t* r = malloc_map( m );
+
+    if( r == NULL ) {
+      return NULL;
+    }
+
+    r->size = 0; r->n = m;
+
+    return ( uint8_t* )( r ) + MALLOC_HEADER;
+  }
+
+  int k = ( n <= MALLOC_MIN ) ? 0 : ( 32 - __builtin_clz( n - 1 ) ) - __builtin_ctz( MALLOC_MIN );
+
+  run_t* r = malloc_runs[ k ];
+
+  if( r == NULL ) {
+    if( NULL == ( r = malloc_map( MALLOC_RUN ) ) ) {
+      return NULL;
+    }
+
+    r->next  = NULL;         r->prev = NULL;
+    r->free  = NULL;         r->used = 0;
+    r->size  = MALLOC_MIN << k;
+    r->fresh = MALLOC_HEADER;
+    r->n     = MALLOC_RUN;
+
+    malloc_runs[ k ] = r;
+  }
+
+  void* x;
+
+  if( r->free != NULL ) {
+    x = r->free; r->free = *( void** )( x );
+  }
+  else {
+    x = ( uint8_t* )( r ) + r->fresh; r->fresh += r->size;
+  }
+
+  // a full run leaves the list, until free gives it a block back
+  if( ++r->used == ( ( MALLOC_RUN - MALLOC_HEADER ) / r->size ) ) {
+    malloc_runs[ k ] = r->next;
+
+    if( r->next != NULL ) {
+      r->next->prev = NULL;
+    }
+  }
+
+  return x;
+}
+
+void  free( void* x ) {
+  if( x == NULL ) {
+    return;
+  }
+
+  run_t* r = ( run_t* )( ( uint32_t )( x ) & ~( MALLOC_RUN - 1 ) );
+
+  if( r->size == 0 ) {
+    munmap( r, r->n ); return;
+  }
+
+  int k = __builtin_ctz( r->size ) - __builtin_ctz( MALLOC_MIN );
 
+  *( void** )( x ) = r->free; r->free = x;
+
+  // a run that was full goes back on the list
+  if( r->used-- == ( ( MALLOC_RUN - MALLOC_HEADER ) / r->size ) ) {
+    r->prev = NULL; r->next = malloc_runs[ k ];
+
+    if( r->next != NULL ) {
+      r->next->prev = r;
+    }
+
+    malloc_runs[ k ] = r;
+  }
+
+  if( ( r->used == 0 ) && ( ( r->prev != NULL ) || ( r->next != NULL ) ) ) {
+    if( r->prev != NULL ) {
+      r->prev->next = r->next;
+    }
+    else {
+      malloc_runs[ k ] = r->next;
+    }
+    if( r->next != NULL ) {
+      r->next->prev = r->prev;
+    }
+
+    munmap( r, r->n );
+  }
+
+  return;
+}
+
+void* calloc( size_t n, size_t m ) {
+  if( ( m != 0 ) && ( n > ( SIZE_MAX / m ) ) ) {
+    return NULL;
+  }
+
+  void* x = malloc( n * m );
+
+  if( x != NULL ) {
+    memset( x, 0, n * m );
+  }
+
+  return x;
+}
+
+void* realloc( void* x, size_t n ) {
+  if( x == NULL ) {
+    return malloc( n );
+  }
+  if( n == 0 ) {
+    free( x ); return NULL;
+  }
+
+  run_t* r = ( run_t* )( ( uint32_t )( x ) & ~( MALLOC_RUN - 1 ) );
+  size_t m = ( r->size == 0 ) ? ( r->n - MALLOC_HEADER ) : r->size;
+
+  if( n <= m ) {
+    return x;
+  }
+
+  void* y = malloc( n );
+
+  if( y != NULL ) {
+    memcpy( y, x, m ); free( x );
+  }
+
+  return y;
+}
+
+// the entry point of every thread, with t (i.e., its thread pointer) in r0
+void thread_start( thread_t* t ) {
+  thread_exit( t->entry( t->arg ) );
+}
+
+int thread_create( thread_t* t, void* ( *entry )( void* ), void* arg ) {
+  t->entry  = entry;
+  t->arg    = arg;
+  t->result = NULL;
+  t->stack  = mmap( THREAD_STACK );
+
+  if( t->stack == NULL ) {
+    return -1;
+  }
+
+  t->tid = clone( &thread_start, ( uint8_t* )( t->stack ) + THREAD_STACK, CLONE_VM | CLONE_FILES | CLONE_THREAD | CLONE_SETTLS, t );
+
+  if( t->tid < 0 ) {
+    munmap( t->stack, THREAD_STACK ); return -1;
+  }
+
+  return 0;
+}
+
+int thread_join( thread_t* t, void** result ) {
+  if( waitpid( t->tid, NULL, 0 ) != t->tid ) {
+    return -1;
+  }
+
+  munmap( t->stack, THREAD_STACK );
+
+  if( result != NULL ) {
+    *result = t->result;
+  }
+
+  return 0;
+}
+
+void thread_exit( void* x ) {
+  thread_t* t = thread_self();
+
+  if( t != NULL ) {
+    t->result = x;
+  }
+
+  exit( EXIT_SUCCESS );
+}
+
+thread_t* thread_self() {
+  thread_t* r;
+
+  asm volatile( "mrc p15, 0, %0, c13, c0, 3 \n" // read TPIDRURO
+              : "=r" (r) );
+
+  return r;
+}
+
+/* Coroutines are scheduled round-robin from coro_ready, a FIFO queue, and
+ * each switch goes straight from one coroutine to the next rather than via
+ * a scheduler.  A coroutine whose pipe I/O cannot make progress parks on
+ * coro_waiting instead: since the kernel cannot say which pipes are ready,
+ * once nothing else is ready the process yields (so whatever is at the
+ * other end of the pipe can execute), then readies every parked coroutine
+ * so each retries.  Once nothing is ready or parked, control returns to
+ * coro_main, i.e., to whoever called coro_run.  A finished coroutine is
+ * still executing on its stack, so whichever executes next unmaps it.
+ */
+
+extern void coro_switch( uint32_t* x, uint32_t* y );
+
+coro_t  coro_main;
+coro_t* coro_current    = NULL;
+coro_t* coro_ready_head = NULL;
+coro_t* coro_ready_tail = NULL;
+coro_t* coro_waiting    = NULL;
+coro_t* coro_dead       = NULL;
+
+void coro_enqueue( coro_t* c ) {
+  c->next = NULL;
+
+  if( coro_ready_tail != NULL ) {
+    coro_ready_tail->next = c;
+  }
+  else {
+    coro_ready_head = c;
+  }
+
+  coro_ready_tail = c;
+}
+
+coro_t* coro_dequeue() {
+  coro_t* c = coro_ready_head;
+
+  if( c != NULL ) {
+    coro_ready_head = c->next;
+
+    if( coro_ready_head == NULL ) {
+      coro_ready_tail = NULL;
+    }
+  }
+
+  return c;
+}
+
+void coro_reap() {
+  if( coro_dead != NULL ) {
+    munmap( coro_dead->stack, CORO_STACK ); free( coro_dead ); coro_dead = NULL;
+  }
+}
+
+// switch from coroutine x to whichever executes next
+void coro_next( coro_t* x ) {
+  coro_t* y = coro_dequeue();
+
+  while( ( y == NULL ) && ( coro_waiting != NULL ) ) {
+    yield();
+
+    for( coro_t* c = coro_waiting, *d; c != NULL; c = d ) {
+      d = c->next; coro_enqueue( c );
+    }
+
+    coro_waiting = NULL;
+    y = coro_dequeue();
+  }
+
+  if( y == NULL ) {
+    y = &coro_main;
+  }
+
+  if( y != x ) {
+    coro_current = y;
+    coro_switch( x->ctx, y->ctx );
+    coro_reap();
+  }
+}
+
+// the entry point of every coroutine, reached via the lr coro_create sets
+void coro_start() {
+  coro_reap();
+  coro_current->entry( coro_current->arg );
+  coro_exit();
+}
+
+// wait for pipe I/O to be possible, i.e., let some other coroutine (or process) execute
+void coro_park() {
+  coro_t* x = coro_current;
+
+  if( ( x == NULL ) || ( x == &coro_main ) ) {
+    yield(); return;
+  }
+
+  x->next = coro_waiting; coro_waiting = x;
+  coro_next( x );
+}
+
+coro_t* coro_create( void ( *entry )( void* ), void* arg ) {
+  coro_t* c = malloc( sizeof( coro_t ) );
+
+  if( c == NULL ) {
+    return NULL;
+  }
+
+  c->stack = mmap( CORO_STACK );
+
+  if( c->stack == NULL ) {
+    free( c ); return NULL;
+  }
+
+  c->entry     = entry;
+  c->arg       = arg;
+  c->ctx[ 8 ]  = ( uint32_t )( c->stack ) + CORO_STACK; // i.e., sp
+  c->ctx[ 9 ]  = ( uint32_t )( &coro_start );            // i.e., lr
+
+  coro_enqueue( c );
+
+  return c;
+}
+
+void coro_run() {
+  coro_current = &coro_main;
+  coro_next( &coro_main );
+  coro_current = NULL;
+}
+
+void coro_yield() {
+  coro_t* x = coro_current;
+
+  if( ( x == NULL ) || ( x == &coro_main ) ) {
+    return;
+  }
+
+  coro_enqueue( x );
+  coro_next( x );
+}
+
+void coro_exit() {
+  coro_t* x = coro_current;
+
+  if( ( x == NULL ) || ( x == &coro_main ) ) {
+    return;
+  }
+
+  coro_dead = x;
+  coro_next( x ); // i.e., never returns
+}
+
+coro_t* coro_self() {
+  return ( coro_current != &coro_main ) ? coro_current : NULL;
+}
+
+int coro_read( int fd, void* x, size_t n ) {
+  int r;
+
+  while( ( ( r = read( fd, x, n ) ) == 0 ) && ( n > 0 ) ) {
+    coro_park();
+  }
+
+  return r;
+}
+
+int coro_write( int fd, const void* x, size_t n ) {
+  for( size_t i = 0; i < n; ) {
+    int r = write( fd, ( const uint8_t* )( x ) + i, n - i );
+
+    if( r < 0 ) {
+      return -1;
+    }
+    else if( r == 0 ) {
+      coro_park();
+    }
+    else {
+      i += r;
+    }
+  }
+
+  return n;
+}
+
+/* Each fd has a buffer iff. its mode is not BUF_NONE and one could be
+ * allocated (if not, the fd just reverts to BUF_NONE).  Formatted output
+ * is put straight into the buffer of the fd, or, for an unbuffered one,
+ * into a temporary buffer on the stack written once formatting is done:
+ * either way it costs a system call per buffer-full at most, rather than
+ * one per conversion.  A buffer is drained via writev, so a write (or a
+ * %s string) at least BUF_SIZE long is never copied into it: it goes out
+ * from where it is, as a second segment behind whatever was buffered.
+ */
+
+buf_t*  buf_table[ BUF_FDS ];
+uint8_t buf_modes[ BUF_FDS ] = { [ STDOUT_FILENO ] = BUF_LINE };
+
+buf_t* buf_get( int fd ) {
+  if( ( fd < 0 ) || ( fd >= BUF_FDS ) || ( buf_modes[ fd ] == BUF_NONE ) ) {
+    return NULL;
+  }
+
+  if( buf_table[ fd ] == NULL ) {
+    buf_table[ fd ] = malloc( sizeof( buf_t ) );
+
+    if( buf_table[ fd ] == NULL ) {
+      buf_modes[ fd ] = BUF_NONE; return NULL;
+    }
+
+    buf_table[ fd ]->n = 0;
+  }
+
+  return buf_table[ fd ];
+}
+
+// write what b holds then n bytes from x to fd, as one writev (then another
+// for whatever a short one leaves); return 0, or -1 on failure
+int buf_drainv( int fd, buf_t* b, const void* x, size_t n ) {
+  iovec_t iov[ 2 ] = { { b->x, b->n }, { ( void* )( x ), n } };
+
+  for( int i = 0; i < 2; ) {
+    if( iov[ i ].len == 0 ) {
+      i++; continue;
+    }
+
+    int r = writev( fd, &iov[ i ], 2 - i );
+
+    if( r < 0 ) {
+      b->n = 0; return -1; // i.e., discard what cannot be written
+    }
+    else if( r == 0 ) {
+      yield();               // i.e., a full pipe, so let the reader catch up
+    }
+
+    for( ; ( i < 2 ) && ( r >= iov[ i ].len ); i++ ) {
+      r -= iov[ i ].len; iov[ i ].len = 0;
+    }
+    if( i < 2 ) {
+      iov[ i ].base = ( char* )( iov[ i ].base ) + r; iov[ i ].len -= r;
+    }
+  }
+
+  b->n = 0;
+
+  return 0;
+}
+
+int buf_drain( int fd, buf_t* b ) {
+  return buf_drainv( fd, b, NULL, 0 );
+}
+
+int buf_putc( int fd, buf_t* b, int mode, char x ) {
+  b->x[ b->n++ ] = x;
+
+  if( ( b->n == BUF_SIZE ) || ( ( mode == BUF_LINE ) && ( x == '\n' ) ) ) {
+    return buf_drain( fd, b );
+  }
+
+  return 0;
+}
+
+int bufmode( int fd, int mode ) {
+  if( ( fd < 0 ) || ( fd >= BUF_FDS ) || ( mode < BUF_NONE ) || ( mode > BUF_FULL ) ) {
+    return -1;
+  }
+
+  int r = bflush( fd );
+
+  if( ( mode == BUF_NONE ) && ( buf_table[ fd ] != NULL ) ) {
+    free( buf_table[ fd ] ); buf_table[ fd ] = NULL;
+  }
+
+  buf_modes[ fd ] = mode;
+
+  return r;
+}
+
+int bwrite( int fd, const void* x, size_t n ) {
+  buf_t* b = buf_get( fd );
+
+  if( b == NULL ) {
+    return write( fd, x, n );
+  }
+
+  int mode = buf_modes[ fd ];
+
+  // a write no smaller than the buffer would only be copied out again, so
+  // write it straight from x, in the same system call as what is buffered
+  if( n >= BUF_SIZE ) {
+    return ( buf_drainv( fd, b, x, n ) < 0 ) ? -1 : n;
+  }
+
+  for( size_t i = 0; i < n; i++ ) {
+    if( buf_putc( fd, b, mode, ( ( const char* )( x ) )[ i ] ) < 0 ) {
+      return -1;
+    }
+  }
+
+  return n;
+}
+
+int bflush( int fd ) {
+  int r = 0;
+
+  if( fd < 0 ) {
+    for( int i = 0; i < BUF_FDS; i++ ) {
+      if( ( buf_table[ i ] != NULL ) && ( buf_drain( i, buf_table[ i ] ) < 0 ) ) {
+        r = -1;
+      }
+    }
+  }
+  else if( ( fd < BUF_FDS ) && ( buf_table[ fd ] != NULL ) ) {
+    r = buf_drain( fd, buf_table[ fd ] );
+  }
+
+  return r;
+}
+
+int buf_format( int fd, const char* f, va_list args ) {
+  buf_t* b = buf_get( fd ), t; int mode, n = 0, e = 0;
+
+  if( b == NULL ) {
+    b = &t; b->n = 0; mode = BUF_FULL;
+  }
+  else {
+    mode = buf_modes[ fd ];
+  }
+
+  #define PUTC(x) { e |= buf_putc( fd, b, mode, ( x ) ); n++; }
+
+  for( ; *f != '\x00'; f++ ) {
+    if( *f != '%' ) {
+      PUTC( *f ); continue;
+    }
+
+    bool left = false, zero = false; int width = 0;
+
+    for( f++; ( *f == '-' ) || ( *f == '0' ); f++ ) {
+      left |= ( *f == '-' ); zero |= ( *f == '0' );
+    }
+    for( ; ( *f >= '0' ) && ( *f <= '9' ); f++ ) {
+      width = ( width * 10 ) + ( *f - '0' );
+    }
+    if( *f == 'l' ) {
+      f++; // i.e., long is the same size as int
+    }
+
+    char d[ 12 ], *s = d + sizeof( d ); int k = 0; bool neg = false;
+
+    switch( *f ) {
+      case 'd' :
+      case 'i' :
+      case 'u' :
+      case 'x' :
+      case 'X' :
+      case 'p' : {
+        uint32_t x    = va_arg( args, uint32_t );
+        uint32_t base = ( ( *f == 'x' ) || ( *f == 'X' ) || ( *f == 'p' ) ) ? 16 : 10;
+        const char* digits = ( *f == 'X' ) ? "0123456789ABCDEF" : "0123456789abcdef";
+
+        if( ( ( *f == 'd' ) || ( *f == 'i' ) ) && ( ( int32_t )( x ) < 0 ) ) {
+          neg = true; x = -x;
+        }
+
+        do {
+          *--s = digits[ x % base ]; x /= base; k++;
+        } while( x );
+
+        break;
+      }
+      case 'c' : {
+        *--s = ( char )( va_arg( args, int ) ); k = 1;
+        break;
+      }
+      case 's' : {
+        s = va_arg( args, char* ); k = strlen( s );
+        break;
+      }
+      case '%' : {
+        *--s = '%'; k = 1;
+        break;
+      }
+      default  : {
+        f--; // i.e., unknown conversion, so output the character itself (or stop, at end of f)
+        continue;
+      }
+    }
+
+    int pad = width - k - neg;
+
+    // likewise, a long string is written straight from s, unpadded
+    if( ( *f == 's' ) && ( k >= BUF_SIZE ) && ( pad <= 0 ) ) {
+      e |= buf_drainv( fd, b, s, k ); n += k;
+      continue;
+    }
+
+    if( neg && zero ) {
+      PUTC( '-' );
+    }
+    for( ; !left && ( pad > 0 ); pad-- ) {
+      PUTC( zero ? '0' : ' ' );
+    }
+    if( neg && !zero ) {
+      PUTC( '-' );
+    }
+    for( int i = 0; i < k; i++ ) {
+      PUTC( s[ i ] );
+    }
+    for( ; left && ( pad > 0 ); pad-- ) {
+      PUTC( ' ' );
+    }
+  }
+
+  #undef PUTC
+
+  if( b == &t ) {
+    e |= buf_drain( fd, b );
+  }
+
+  return e ? -1 : n;
+}
+
+int dprintf( int fd, const char* f, ... ) {
+  va_list args; va_start( args, f );
+  int r = buf_format( fd, f, args );
+  va_end( args );
+
+  return r;
+}
+
+int  printf( const char* f, ... ) {
+  va_list args; va_start( args, f );
+  int r = buf_format( STDOUT_FILENO, f, args );
+  va_end( args );
+
+  return r;
+}
@@ -12,16 +12,108 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "SYS.h"
+
 // Define a type that that captures a Process IDentifier (PID).
 
 typedef int pid_t;
 
+// Define a type that captures usage statistics for a kernel object cache.
+
+typedef struct {
+  char     name[ 8 ];
+  uint32_t size, used, total, peak;
+} slabinfo_t;
+
+// Define types that capture attributes for, and a batch entry of, spawn.
+
+typedef struct {
+  uint32_t flags;    // SPAWN_* attributes that apply
+  int      priority; // base priority, between 1 and 15 (iff. SPAWN_PRIORITY)
+  int      niceness; // niceness, between -20 and 19 (iff. SPAWN_NICE)
+  uint32_t stack;    // stack size, or 0 for the default
+} spawn_attr_t;
+
+typedef struct {
+  const void* entry;      // entry point
+  uint32_t    args[ 4 ];  // initial r0-r3, i.e., up to 4 arguments
+  pid_t       pid;        // PID of new process, or -1 if it was not created
+} spawn_t;
+
+/* Define a type that captures the page of data the kernel publishes at
+ * KDATA_BASE, which every process can read without a system call: each
+ * update leaves seq incremented twice, and odd in between, so a reader
+ * retries until it sees the same even seq before and after reading.
+ */
+
+#define KDATA_BASE    ( 0x3FF00000 )
+
+typedef struct {
+  volatile uint32_t seq;      // update count, times 2 (plus 1 during an update)
+  uint32_t          wraps;    // times COUNTER_24MHZ had wrapped, as of last
+  uint32_t          last;     // COUNTER_24MHZ when last sampled
+  uint32_t          ticks;    // timer ticks since boot
+  pid_t             pid;      // PID of executing process
+  uint32_t          switches; // context switches since boot
+  uint32_t          runnable; // processes ready or executing, as of last schedule
+  uint32_t          procs;    // live processes (including zombies and kernel threads)
+} kdata_t;
+
+#define KDATA         ( ( const volatile kdata_t* )( KDATA_BASE ) )
+
+/* Define types that capture a submission/completion ring, i.e., a page
+ * shared with the kernel: fill an entry from ring_sqe, publish it with
+ * ring_submit, then make one ring_enter call for any number of them (or
+ * none, iff. the ring was set up with RING_SETUP_POLL, since the kernel
+ * then consumes them each time it returns to the process).  A read or a
+ * write moves at most RING_MAX_LEN bytes, so may complete short.
+ * Completions are reaped from memory via ring_cqe then ring_cqe_seen;
+ * those on one fd arrive in order, but otherwise user_data says which is
+ * which.
+ */
+
+#define RING_SQ          ( 64 )
+#define RING_CQ          ( 128 )
+#define RING_MAX_LEN     ( 4096 )
+
+#define RING_SETUP_POLL  ( 0x01 ) // consume entries on each return to the process
+#define RING_ENTER_YIELD ( 0x01 ) // yield once entries are consumed
+
+#define RING_NOP         ( 0x00 ) // complete straight away, with result 0
+#define RING_READ        ( 0x01 ) // read up to len bytes from fd into addr
+#define RING_WRITE       ( 0x02 ) // write up to len bytes to fd from addr
+#define RING_POLL        ( 0x03 ) // wait for fd to be readable, with result bytes ready
+#define RING_SLEEP       ( 0x04 ) // wait for len microseconds
+
+typedef struct {
+  uint16_t op;        // RING_* operation
+  int16_t  fd;        // file descriptor, iff. op uses one
+  uint32_t addr;      // buffer address, iff. op uses one
+  uint32_t len;       // buffer length (or time, for RING_SLEEP)
+  uint32_t user_data; // copied into completion
+} ring_sqe_t;
+
+typedef struct {
+  uint32_t user_data; // as submitted
+  int32_t  res;       // result, as per the corresponding system call
+} ring_cqe_t;
+
+typedef struct {
+  volatile uint32_t sq_head;        // written by kernel
+  volatile uint32_t sq_tail;        // written by process
+  volatile uint32_t cq_head;        // written by process
+  volatile uint32_t cq_tail;        // written by kernel
+  uint32_t          reserved[ 12 ];
+  ring_sqe_t        sq[ RING_SQ ];
+  ring_cqe_t        cq[ RING_CQ ];
+} ring_t;
+
 /* The definitions below capture symbolic constants within these classes:
  *
  * 1. system call identifiers (i.e., the constant used by a system call
  *    to specify which action the kernel should take),
  * 2. signal identifiers (as used by the kill system call), 
- * 3. status codes for exit,
+ * 3. status codes for exit, and options for waitpid,
  * 4. standard file descriptors (e.g., for read and write system calls),
  * 5. platform-specific constants, which may need calibration (wrt. the
  *    underlying hardware QEMU is executed on).
@@ -39,17 +131,146 @@ typedef int pid_t;
 #define SYS_KILL      ( 0x06 )
 #define SYS_NICE      ( 0x07 )
 #define SYS_PIPE      ( 0x08 )
+#define SYS_WAITPID   ( 0x09 )
+#define SYS_CLOSE     ( 0x0A )
+#define SYS_MEMINFO   ( 0x0B )
+#define SYS_SLABINFO  ( 0x0C )
+#define SYS_STACKINFO ( 0x0D )
+#define SYS_FAULTINFO ( 0x0E )
+#define SYS_SBRK      ( 0x0F )
+#define SYS_MMAP      ( 0x10 )
+#define SYS_MUNMAP    ( 0x11 )
+#define SYS_SHMMAP    ( 0x12 )
+#define SYS_SHMUNMAP  ( 0x13 )
+#define SYS_SPAWN     ( 0x14 )
+#define SYS_SPAWNV    ( 0x15 )
+#define SYS_DMAP      ( 0x16 )
+#define SYS_MSYNC     ( 0x17 )
+#define SYS_CLONE     ( 0x18 )
+#define SYS_RING_SETUP ( 0x19 )
+#define SYS_RING_ENTER ( 0x1A )
+#define SYS_WRITEV    ( 0x1B )
+#define SYS_READV     ( 0x1C )
 
 #define SIG_TERM      ( 0x00 )
 #define SIG_QUIT      ( 0x01 )
+#define SIG_SEGV      ( 0x0B )
 
 #define EXIT_SUCCESS  ( 0 )
 #define EXIT_FAILURE  ( 1 )
 
+#define WNOHANG       ( 0x01 )
+
+#define SPAWN_FDS      ( 0x01 ) // inherit every fd, not just 0, 1 and 2
+#define SPAWN_PRIORITY ( 0x02 ) // use priority given, not default
+#define SPAWN_NICE     ( 0x04 ) // use niceness given, not parent's
+#define SPAWN_MAX      ( 16 )   // processes one spawnv can create
+
+#define CLONE_VM       ( 0x01 ) // share address space, rather than copy it
+#define CLONE_FILES    ( 0x02 ) // share fd table, rather than inherit each fd
+#define CLONE_THREAD   ( 0x04 ) // join thread group of parent
+#define CLONE_SETTLS   ( 0x08 ) // set thread pointer (i.e., TPIDRURO) to x
+
 #define  STDIN_FILENO ( 0 )
 #define STDOUT_FILENO ( 1 )
 #define STDERR_FILENO ( 2 )
 
+#define PAGE_SIZE     ( 0x1000 )
+
+/* malloc serves requests of up to MALLOC_MAX bytes from runs, i.e., blocks
+ * of MALLOC_RUN bytes (aligned to MALLOC_RUN) carved into equal size
+ * blocks: size classes are powers of two, from MALLOC_MIN upward.  Each
+ * larger request is mapped (then unmapped by free) on its own.
+ */
+
+#define MALLOC_MIN     ( 16 )
+#define MALLOC_MAX     ( 2048 )
+#define MALLOC_CLASSES ( 8 )      // i.e., MALLOC_MIN << k for 0 <= k < 8
+#define MALLOC_RUN     ( 0x4000 )
+#define MALLOC_HEADER  ( 32 )     // bytes reserved for run_t at start of a run
+
+typedef struct run {
+  struct run* next;  // next     run of same class with a free block
+  struct run* prev;  // previous run of same class with a free block
+  void*       free;  // free list of blocks, threaded through first word
+  uint32_t    size;  // block size, or 0 for a single large allocation
+  uint32_t    used;  // blocks in use
+  uint32_t    fresh; // offset of first block never allocated
+  uint32_t    n;     // bytes mapped
+} run_t;
+
+/* A thread is a process created by clone which shares the address space,
+ * file descriptors and thread group of its creator; the thread pointer
+ * (i.e., TPIDRURO) of each one points at its thread_t, which the creator
+ * provides (so it must outlive the thread), and which holds the entry
+ * point, argument and result.  The stack, of THREAD_STACK bytes, is mapped
+ * by thread_create and unmapped by thread_join.  Any thread in the group
+ * can join any other.  Note that nothing else in libc (e.g., malloc) is
+ * safe to use from more than one thread at once.
+ */
+
+#define THREAD_STACK   ( 0x4000 )
+
+typedef struct thread {
+  void*  ( *entry )( void* ); // entry point
+  void*  arg;                 // argument passed to entry
+  void*  result;              // value entry returned, or passed to thread_exit
+  void*  stack;               // base of stack mapped for thread
+  pid_t  tid;                 // PID of thread
+} thread_t;
+
+/* A coroutine is a task scheduled entirely within one process, so needs
+ * no PCB, and switching between coroutines never enters the kernel (see
+ * coro.s): each one has a stack of CORO_STACK bytes (committed on demand,
+ * so typically one page), and executes until it yields, parks waiting for
+ * pipe I/O, or returns.  coro_run executes every coroutine created so far
+ * (plus any they create) round-robin, returning once all have finished.
+ */
+
+#define CORO_STACK     ( 0x2000 )
+
+typedef struct coro {
+  uint32_t     ctx[ 10 ];         // r4-r11, sp and lr, as preserved by coro_switch
+  void       ( *entry )( void* ); // entry point
+  void*        arg;               // argument passed to entry
+  void*        stack;             // base of stack
+  struct coro* next;              // next coroutine in same queue
+} coro_t;
+
+/* Define a type that captures one segment of a vectored read or write,
+ * i.e., readv or writev, which move up to IOV_MAX such segments in one
+ * system call: the result is as if the segments were laid end to end.
+ */
+
+#define IOV_MAX       ( 16 )
+
+typedef struct {
+  void*  base; // address of segment
+  size_t len;  // length of segment in bytes
+} iovec_t;
+
+/* Output to a file descriptor can be buffered, so many small writes cost
+ * one system call: a BUF_LINE buffer (the default for stdout) is flushed
+ * by each newline written to it, and a BUF_FULL one once it fills, but
+ * BUF_NONE (the default for every other fd, so pipes used as channels
+ * behave as before) means writes go straight through.  Buffers are
+ * allocated on first use, and flushed by exit, fork and exec (so output is
+ * neither lost nor duplicated), by close of the fd, and for stdout, by any
+ * read from stdin.  As for malloc, none of this is thread-safe.
+ */
+
+#define BUF_FDS       ( 250 ) // i.e., MAX_FDS in the kernel
+#define BUF_SIZE      ( 256 )
+
+#define BUF_NONE      ( 0 )   // unbuffered
+#define BUF_LINE      ( 1 )   // line buffered
+#define BUF_FULL      ( 2 )   // fully buffered
+
+typedef struct {
+  size_t n;                   // bytes buffered
+  char   x[ BUF_SIZE ];       // bytes buffered
+} buf_t;
+
 // convert ASCII string x into integer r
 extern int  atoi( char* x        );
 // convert integer x into ASCII string r
@@ -60,8 +281,12 @@ extern void yield();
 
 // write n bytes from x to   the file descriptor fd; return bytes written
 extern int write( int fd, const void* x, size_t n );
-// read  n bytes into x from the file descriptor fd; return bytes read
+// read  n bytes into x from the file descriptor fd; return bytes read (-1 at end of file)
 extern int  read( int fd,       void* x, size_t n );
+// write n segments from iov to   the file descriptor fd; return bytes written
+extern int writev( int fd, const iovec_t* iov, int n );
+// read  n segments into iov from the file descriptor fd; return bytes read
+extern int  readv( int fd, const iovec_t* iov, int n );
 
 // perform fork, returning 0 iff. child or > 0 iff. parent process
 extern int  fork();
@@ -69,6 +294,12 @@ extern int  fork();
 extern void exit(       int   x );
 // perform exec, i.e., start executing program at address x
 extern void exec( const void* x );
+// perform exec, as above, but with a stack of n bytes (or the current size iff. n = 0)
+extern void exec_stack( const void* x, size_t n );
+// create child process executing from x with args (iff. not NULL) in r0-r3, per attrs (iff. not NULL); return pid
+extern pid_t spawn( const void* x, const uint32_t* args, const spawn_attr_t* attrs );
+// create n <= SPAWN_MAX child processes, as above, storing each pid in x; return number created, stopping at first failure (or -1 on error)
+extern int spawnv( spawn_t* x, int n, const spawn_attr_t* attrs );
 
 // for process identified by pid, send signal of x
 extern int  kill( pid_t pid, int x );
@@ -76,6 +307,152 @@ extern int  kill( pid_t pid, int x );
 extern void nice( pid_t pid, int x );
 // IPC pipe, finds first 2 positions in fdtable and allocates them for read and write ends of pipe
 extern int pipe( int fds[2] );
+// close file descriptor fd, deallocating any pipe no longer referred to
+extern int close( int fd );
+
+// wait for child pid (or any child iff. pid = -1) to exit, storing exit status in status; return pid
+extern int waitpid( pid_t pid, int* status, int options );
+// wait for any child to exit, storing exit status in status; return pid
+extern int wait( int* status );
+
+// store free block count for each of first n orders of page allocator in x; return number of orders
+extern int meminfo( uint32_t* x, int n );
+// store usage statistics for each of first n kernel object caches in x; return number of caches
+extern int slabinfo( slabinfo_t* x, int n );
+// store stack size then high-water mark (i.e., most bytes used) of process pid in x
+extern int stackinfo( pid_t pid, uint32_t* x );
+// store copy-on-write, demand, minor then swap-in fault counts, then resident pages, of process pid in x
+extern int faultinfo( pid_t pid, uint32_t* x );
+
+// move heap break by n bytes; return previous break, or (void*)( -1 ) on failure
+extern void* sbrk( intptr_t n );
+// map n bytes (rounded up to a page) of zero-filled memory; return address, or NULL on failure
+extern void* mmap( size_t n );
+// unmap n bytes from (page aligned) address x
+extern int munmap( void* x, size_t n );
+// map shared memory object with key x (or a new anonymous one iff. x = 0), creating it with n bytes iff. need be
+extern void* shmmap( uint32_t x, size_t n );
+// unmap the shared memory object mapped at address x
+extern int shmunmap( void* x );
+// map n bytes of the disk from block a onward, read on demand; return address, or NULL on failure
+extern void* dmap( uint32_t a, size_t n );
+// write back the dirty pages of disk mappings among n bytes from address x
+extern int msync( void* x, size_t n );
+
+// create process starting at entry on stack with x in r0, sharing whatever flags says with caller; return pid, or -1 on failure
+extern int clone( void* entry, void* stack, uint32_t flags, void* x );
+
+// create thread t that executes entry( arg ); return 0, or -1 on failure
+extern int thread_create( thread_t* t, void* ( *entry )( void* ), void* arg );
+// wait for thread t to finish, storing its result in result (iff. not NULL); return 0, or -1 on failure
+extern int thread_join( thread_t* t, void** result );
+// finish executing thread, with result x
+extern void thread_exit( void* x );
+// return executing thread, or NULL if it was not created by thread_create
+extern thread_t* thread_self();
+
+// create coroutine that executes entry( arg ) once coro_run is called; return it, or NULL on failure
+extern coro_t* coro_create( void ( *entry )( void* ), void* arg );
+// execute coroutines until every one has finished
+extern void coro_run();
+// let the next ready coroutine execute
+extern void coro_yield();
+// finish executing coroutine
+extern void coro_exit();
+// return executing coroutine, or NULL if not within coro_run
+extern coro_t* coro_self();
+// read up to n bytes into x from pipe fd, parking the coroutine until there is at least one (or -1 at end of file)
+extern int coro_read( int fd, void* x, size_t n );
+// write n bytes from x to pipe fd, parking the coroutine whenever it is full
+extern int coro_write( int fd, const void* x, size_t n );
+
+// return 24MHz ticks since boot (or rather, since COUNTER_24MHZ was 0), without a system call
+static inline uint64_t kclock() {
+  uint32_t s, wraps, last, x;
+
+  do {
+    s     = KDATA->seq;
+    wraps = KDATA->wraps;
+    last  = KDATA->last;
+    x     = SYSCONF->COUNTER_24MHZ;
+  } while( ( s & 1 ) || ( s != KDATA->seq ) );
+
+  return ( ( uint64_t )( wraps + ( ( x < last ) ? 1 : 0 ) ) << 32 ) | x;
+}
+
+// return PID of executing process, without a system call
+static inline pid_t getpid() {
+  return KDATA->pid; // i.e., a single word, so needs no retry
+}
+
+// store copy of kernel data in x, without a system call
+static inline void kstat( kdata_t* x ) {
+  uint32_t s;
+
+  do {
+    s = KDATA->seq;
+    x->wraps    = KDATA->wraps;
+    x->last     = KDATA->last;
+    x->ticks    = KDATA->ticks;
+    x->pid      = KDATA->pid;
+    x->switches = KDATA->switches;
+    x->runnable = KDATA->runnable;
+    x->procs    = KDATA->procs;
+  } while( ( s & 1 ) || ( s != KDATA->seq ) );
+
+  x->seq = s;
+}
+
+// set up a submission/completion ring, with RING_SETUP_* flags; return it, or NULL on failure
+extern ring_t* ring_setup( uint32_t flags );
+// consume submitted entries, with RING_ENTER_* flags; return completions to reap, or -1 on failure
+extern int ring_enter( uint32_t flags );
+
+// return next free submission entry of r, or NULL if the queue is full
+static inline ring_sqe_t* ring_sqe( ring_t* r ) {
+  uint32_t tail = r->sq_tail;
+
+  return ( ( tail - r->sq_head ) < RING_SQ ) ? &r->sq[ tail % RING_SQ ] : NULL;
+}
+
+// publish the entry ring_sqe returned, so the kernel can consume it
+static inline void ring_submit( ring_t* r ) {
+  asm volatile( "" ::: "memory" ); // i.e., the entry is written before it is published
+  r->sq_tail++;
+}
+
+// return next completion of r, or NULL if there is none yet
+static inline ring_cqe_t* ring_cqe( ring_t* r ) {
+  uint32_t head = r->cq_head;
+
+  return ( head != r->cq_tail ) ? &r->cq[ head % RING_CQ ] : NULL;
+}
+
+// mark the completion ring_cqe returned as reaped
+static inline void ring_cqe_seen( ring_t* r ) {
+  asm volatile( "" ::: "memory" ); // i.e., the entry is read before it is reused
+  r->cq_head++;
+}
+
+// allocate n bytes; return address, or NULL on failure
+extern void* malloc( size_t n );
+// allocate n zero-filled elements of m bytes each
+extern void* calloc( size_t n, size_t m );
+// resize allocation at x to n bytes, moving it iff. need be
+extern void* realloc( void* x, size_t n );
+// deallocate allocation at x
+extern void  free( void* x );
+
+// set buffering of fd to mode BUF_*, flushing whatever is buffered; return 0, or -1 on failure
+extern int  bufmode( int fd, int mode );
+// write n bytes from x to fd via its buffer; return bytes written, or -1 on failure
+extern int  bwrite( int fd, const void* x, size_t n );
+// flush buffer of fd, or of every fd iff. fd < 0; return 0, or -1 on failure
+extern int  bflush( int fd );
+// write output formatted per f (%d, %i, %u, %x, %X, %p, %c, %s or %%) to fd via its buffer; return bytes written, or -1 on failure
+extern int dprintf( int fd, const char* f, ... );
+// write output formatted per f to stdout via its buffer; return bytes written, or -1 on failure
+extern int  printf( const char* f, ... );
 
 
 
@@ -0,0 +1,82 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "membench.h"
+
+/* This measures the time taken to process MEMBENCH_BYTES in calls of n
+ * bytes each, for n from 8 bytes to MEMBENCH_MAX doubling each time (plus
+ * 68, i.e., a ctx_t), via
+ *
+ * - memcpy between word-aligned buffers,
+ * - memcpy from a buffer offset by one byte, i.e., misaligned wrt. the
+ *   destination,
+ * - memset, and
+ * - memcmp of equal buffers, so every byte is compared,
+ *
+ * using the 24MHz counter, so each time is in units of ~42ns.  Building
+ * with PROJECT_MEMOPS = 0 then 1 (see the Makefile) compares the newlib
+ * routines with those in kernel/mem.s, and building with VM_CACHES = 1
+ * then 0 (see kernel/vm.h) what the caches are worth.  A timer interrupt
+ * may land in any measurement, so repeat a run before trusting a
+ * difference of a few %.
+ */
+
+volatile int membench_sink; // i.e., so the memcmp results are not discarded
+
+uint32_t membench_run( int op, char* x, char* y, int n ) {
+  uint32_t t0 = SYSCONF->COUNTER_24MHZ;
+
+  for( int done = 0; done < MEMBENCH_BYTES; done += n ) {
+    switch( op ) {
+      case 0 : memcpy( x, y,     n ); break;
+      case 1 : memcpy( x, y + 1, n ); break;
+      case 2 : memset( x, 0x5A,  n ); break;
+      case 3 : membench_sink += memcmp( x, y, n ); break;
+    }
+  }
+
+  uint32_t t1 = SYSCONF->COUNTER_24MHZ;
+
+  return t1 - t0;
+}
+
+void main_membench() {
+  int sizes[] = { 8, 16, 32, 64, 68, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, MEMBENCH_MAX };
+  int n = MEMBENCH_MAX + PAGE_SIZE; // i.e., room for y + 1
+  char* x = mmap( n );
+  char* y = mmap( n );
+
+  if( ( x == NULL ) || ( y == NULL ) ) {
+    exit( EXIT_FAILURE );
+  }
+
+  memset( x, 0xA5, n ); // i.e., commit the pages first, and make x equal y
+  memset( y, 0xA5, n );
+
+  printf( "\n%8s %10s %10s %10s %10s\n", "bytes", "memcpy", "memcpy+1", "memset", "memcmp" );
+
+  for( int k = 0; k < ( sizeof( sizes ) / sizeof( int ) ); k++ ) {
+    int i = sizes[ k ];
+
+    printf( "%8d", i );
+
+    for( int op = 0; op < 4; op++ ) {
+      if( op == 3 ) {
+        memcpy( x, y, i ); // i.e., undo memset
+      }
+
+      printf( " %10u", membench_run( op, x, y, i ) );
+    }
+
+    printf( "\n" );
+  }
+
+  munmap( x, n );
+  munmap( y, n );
+
+  exit( EXIT_SUCCESS );
+}
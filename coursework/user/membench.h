@@ -0,0 +1,24 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __MEMBENCH_H
+#define __MEMBENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "SYS.h"
+
+#include "libc.h"
+
+#define MEMBENCH_BYTES ( 0x00100000 ) // i.e., 1MB per measurement
+#define MEMBENCH_MAX   ( 0x00010000 ) // i.e., 64KB
+
+#endif
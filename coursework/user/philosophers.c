@@ -1,6 +1,6 @@
 #include "philosophers.h"
 
-// spawn 16 philosophers using fork- child processes
+// spawn 16 philosophers as child processes, all at once using spawnv
 // The Problem : Each philosopher must alternately THINK and EAT.
 //However, a philosopher can only eat spaghetti when they have both left and right forks.
 // Each fork can be held by only one philosopher and so a philosopher can use the fork
@@ -18,7 +18,7 @@
 // i = 2 -> forks[1], forks[2]
 // i = 3 -> forks[2], forks[3]  so for philosopher[i], forks[i] on the right hand side, forks[i-1] on the left
 // the freerightfork and freeleftfork are functions that make the left and right fork available when called
-// the PhiloID(ID) function prints out Philosopher ID, used for printing out which philosopher is doing the action
+// the PhiloID(ID, x) function prints out Philosopher ID followed by the action x, via the buffered printf (so one system call per line)
 // think and eat are simple functions printing out when the current philosopher is either thinking or eating
 // requestleftfork and requestrightfork are communicating with the waiter, asking for the left and right fork
 // which may not be available depending on either if they are reserved by another philosopher
@@ -30,6 +30,9 @@
 // and a pipe from the waiter to the philosopher; through these pipes, the philosopher can request a fork from the waiter
 // through the 2 requestforks functions I have created, or he can hand a fork back if he is the owner of it;
 // they're both infinite loops so that the program runs forever.
+// each request to the waiter and the wait for its reply is one askwaiter(), which submits both the write and the read
+// via the philosopher's ring, so they take one ring_enter between them rather than a write and a read system call
+// (checking both results, and falling back to plain write and read system calls if the ring fails)
 
 
 // MUTUAL EXCLUSION + STARVATION
@@ -50,6 +53,96 @@
 #define FORKSNO 16
 
 forks_t forks[FORKSNO];
+ring_t *waiterring = NULL; // this philosopher's ring, or NULL if it could not be set up
+
+#define ASKWRITE 1 // user_data of the write carrying a request
+#define ASKREAD 2  // user_data of the read waiting for the reply
+
+// queue op on fd with buffer x of n bytes on the ring, tagged with tag
+void queueop(int op, int fd, void *x, int n, uint32_t tag)
+{
+    ring_sqe_t *sqe = ring_sqe(waiterring);
+
+    sqe->op = op;
+    sqe->fd = fd;
+    sqe->addr = (uint32_t)(x);
+    sqe->len = n;
+    sqe->user_data = tag;
+
+    ring_submit(waiterring);
+}
+
+// send the 2 byte request req to the waiter then wait for its 1 byte reply
+void askwaiter(int readfd, int writefd, char *req, char *reply)
+{
+    if (waiterring == NULL)
+    {
+        write(writefd, req, 2);
+        read(readfd, reply, 1);
+        return;
+    }
+
+    queueop(RING_WRITE, writefd, req, 2, ASKWRITE);
+    queueop(RING_READ, readfd, reply, 1, ASKREAD);
+
+    if (ring_enter(0) < 0)
+    {
+        // the entries were never consumed, so drop the ring and ask directly
+        printf("Ring enter failed, asking the waiter directly \n");
+        waiterring = NULL;
+        askwaiter(readfd, writefd, req, reply);
+        return;
+    }
+
+    // the read stays pending in the kernel until the waiter replies, so reap
+    // the completions (in whichever order they arrive) until the read's has
+    bool replied = false;
+    while (replied == false)
+    {
+        ring_cqe_t *cqe = ring_cqe(waiterring);
+
+        if (cqe == NULL)
+        {
+            ring_enter(RING_ENTER_YIELD);
+            continue;
+        }
+
+        uint32_t tag = cqe->user_data;
+        int res = cqe->res;
+        ring_cqe_seen(waiterring);
+
+        if ((tag == ASKWRITE) && (res != 2))
+        {
+            // the waiter never got the whole request, so would never reply:
+            // write whatever is left directly
+            printf("Ring write to waiter failed, writing directly \n");
+
+            for (int sent = (res > 0) ? res : 0, r; sent < 2; sent += r)
+            {
+                if ((r = write(writefd, req + sent, 2 - sent)) < 0)
+                {
+                    printf("Waiter cannot be reached \n");
+                    exit(EXIT_FAILURE);
+                }
+                else if (r == 0)
+                {
+                    yield(); // i.e., the pipe is full for now
+                }
+            }
+        }
+        else if (tag == ASKREAD)
+        {
+            if (res != 1)
+            {
+                // no reply, so the caller sees neither "y" nor "o" and retries
+                printf("Ring read from waiter failed \n");
+                reply[0] = '\0';
+            }
+
+            replied = true;
+        }
+    }
+}
 
 void freerightfork(int i)
 {
@@ -71,25 +164,20 @@ void freeleftfork(int i)
 }
 
 
-void PhiloID(int ID)
+void PhiloID(int ID, char *x)
 {
-    char idbuffer[3];
-    itoa(idbuffer, (ID + 1));
-    write(STDOUT_FILENO, "Philosopher", 12);
-    write(STDOUT_FILENO, idbuffer, 3);
+    printf("Philosopher%d%s", (ID + 1), x);
 }
 
 void think(int ID)
 {
-    PhiloID(ID);
-    write(STDOUT_FILENO, "is thinking \n", 14);
+    PhiloID(ID, "is thinking \n");
     yield();
 }
 
 void eat(int ID)
 {
-    PhiloID(ID);
-    write(STDOUT_FILENO, "is eating \n", 12);
+    PhiloID(ID, "is eating \n");
 }
 
 void requestleftfork(int readfd, int writefd, int ID)
@@ -101,18 +189,16 @@ void requestleftfork(int readfd, int writefd, int ID)
     bool leftforkreceived = false;
     while (leftforkreceived == false)
     {
-        write(writefd, "RL", 2);
-        read(readfd, reading, 1);
+        askwaiter(readfd, writefd, "RL", reading);
 
         if (0 == strcmp(reading, "y"))
         {
-            PhiloID(ID);
-            write(STDOUT_FILENO, "picked up left fork \n", 22);
+            PhiloID(ID, "picked up left fork \n");
             leftforkreceived = true;
         }
         else
         {
-            write(STDOUT_FILENO, "Left fork not available yet \n", 30);
+            printf("Left fork not available yet \n");
             yield();
         }
     }
@@ -126,18 +212,16 @@ void requestrightfork(int readfd, int writefd, int ID)
     bool rightforkreceived = false;
     while (rightforkreceived == false)
     {
-        write(writefd, "RR", 2);
-        read(readfd, reading, 1);
+        askwaiter(readfd, writefd, "RR", reading);
 
         if (0 == strcmp(reading, "y"))
         {
-            PhiloID(ID);
-            write(STDOUT_FILENO, "picked up right fork \n", 23);
+            PhiloID(ID, "picked up right fork \n");
             rightforkreceived = true;
         }
         else
         {
-            write(STDOUT_FILENO, "Right fork not available yet \n", 31);
+            printf("Right fork not available yet \n");
             yield();
         }
     }
@@ -151,13 +235,11 @@ void giveleftfork(int readfd, int writefd, int ID)
     //give left fork to waiter;
     while (releasedfork == false)
     {
-        write(writefd, "GL", 2);
-        read(readfd, reading, 1);
+        askwaiter(readfd, writefd, "GL", reading);
 
         if (0 == strcmp(reading, "o"))
         {
-            PhiloID(ID);
-            write(STDOUT_FILENO, "released left fork \n", 21);
+            PhiloID(ID, "released left fork \n");
             releasedfork = true;
         }
         else
@@ -175,12 +257,10 @@ void giverightfork(int readfd, int writefd, int ID)
 
     while (releasedfork == false)
     {
-        write(writefd, "GR", 2);
-        read(readfd, reading, 1);
+        askwaiter(readfd, writefd, "GR", reading);
         if (0 == strcmp(reading, "o"))
         {
-            PhiloID(ID);
-            write(STDOUT_FILENO, "released right fork \n", 22);
+            PhiloID(ID, "released right fork \n");
             releasedfork = true;
         }
         else
@@ -307,13 +387,20 @@ void forksavailable()
     }
 }
 
+// entry point of each spawned philosopher, with readfd, writefd and ID in r0-r2
+void main_philosopher(int readfd, int writefd, int ID)
+{
+    waiterring = ring_setup(0);
+    philosopher(readfd, writefd, ID);
+    exit(EXIT_SUCCESS);
+}
+
 void main_philosophers()
 {
 
     int waiter_readfd[FORKSNO];
     int waiter_writefd[FORKSNO];
-    int readfd;
-    int writefd;
+    spawn_t philosophers[FORKSNO];
 
     for (int i = 0; i < FORKSNO; i++)
     {
@@ -325,19 +412,19 @@ void main_philosophers()
         pipe(fd_p_to_w);
 
         waiter_readfd[i] = fd_p_to_w[0];
-        writefd = fd_p_to_w[1];
-
         waiter_writefd[i] = fd_w_to_p[1];
-        readfd = fd_w_to_p[0];
 
-        int pid = fork();
-        if (pid == 0)
-        {
-            philosopher(readfd, writefd, i);
-            exit(EXIT_SUCCESS);
-        }
+        philosophers[i].entry = (const void *)(&main_philosopher);
+        philosophers[i].args[0] = fd_w_to_p[0]; // readfd
+        philosophers[i].args[1] = fd_p_to_w[1]; // writefd
+        philosophers[i].args[2] = i;
     }
 
+    // the philosophers need the pipes, so inherit every fd
+    spawn_attr_t attrs = { .flags = SPAWN_FDS };
+
+    spawnv(philosophers, FORKSNO, &attrs);
+
     for (int i = 0; i < FORKSNO; i++)
     {
         forks[i].owner = -1;
@@ -0,0 +1,96 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "pipebench.h"
+
+/* This measures the time taken to move PIPEBENCH_BYTES from a parent to
+ * a child through a pipe, in chunks of PIPEBENCH_CHUNK pages, for
+ *
+ * - copy, i.e., buffers offset by one byte, so every byte is copied into
+ *   and then out of the pipe buffer, and
+ * - flip, i.e., page-aligned buffers, so whole pages are lent to the pipe
+ *   then mapped by the child,
+ *
+ * using the 24MHz counter, so each time is in units of ~42ns; the clock
+ * starts once fork returns in the parent, so excludes the fork itself.
+ * Each is measured twice: once with the writer leaving its buffer alone,
+ * and once (i.e., "dirty") with it rewriting the buffer before each write,
+ * as a real producer would, so the flip time then includes the
+ * copy-on-write fault taken on every page lent to the pipe.
+ */
+
+void pipebench_report( char* x, uint32_t t ) {
+  char r[ 12 ];
+
+  write( STDOUT_FILENO, x, strlen( x ) );
+  itoa( r, PIPEBENCH_BYTES ); write( STDOUT_FILENO, r, strlen( r ) );
+  write( STDOUT_FILENO, " bytes => ", 10 );
+  itoa( r, t ); write( STDOUT_FILENO, r, strlen( r ) );
+  write( STDOUT_FILENO, "\n", 1 );
+}
+
+// move n bytes at a time between x and fd (out of x iff. out), until PIPEBENCH_BYTES are done;
+// iff. dirty, a writer rewrites x before each chunk
+void pipebench_move( int fd, char* x, int n, bool out, bool dirty ) {
+  bool fresh = true;
+
+  for( int done = 0; done < PIPEBENCH_BYTES; ) {
+    if( out && dirty && fresh ) {
+      memset( x, done >> 12, n );
+    }
+
+    int r = out ? write( fd, x, n ) : read( fd, x, n );
+
+    if( r > 0 ) {
+      done += r; fresh = true;
+    }
+    else {
+      yield(); fresh = false;
+    }
+  }
+}
+
+uint32_t pipebench_run( int offset, bool dirty ) {
+  int n = PIPEBENCH_CHUNK * PAGE_SIZE;
+  char* x = mmap( n + PAGE_SIZE );
+  int fds[ 2 ];
+
+  if( ( x == NULL ) || ( pipe( fds ) != 0 ) ) {
+    return 0;
+  }
+
+  memset( x, 0xA5, n + PAGE_SIZE ); // i.e., commit the pages first
+
+  pid_t pid = fork();
+
+  if( 0 == pid ) {
+    pipebench_move( fds[ 0 ], x + offset, n, false, false );
+    exit( EXIT_SUCCESS );
+  }
+
+  uint32_t t0 = SYSCONF->COUNTER_24MHZ;
+
+  pipebench_move( fds[ 1 ], x + offset, n, true, dirty );
+  waitpid( pid, NULL, 0 );
+
+  uint32_t t1 = SYSCONF->COUNTER_24MHZ;
+
+  close( fds[ 0 ] );
+  close( fds[ 1 ] );
+  munmap( x, n + PAGE_SIZE );
+
+  return t1 - t0;
+}
+
+void main_pipebench() {
+  pipebench_report( "\ncopy       ", pipebench_run( 1, false ) );
+  pipebench_report( "\nflip       ", pipebench_run( 0, false ) );
+  pipebench_report( "\ncopy dirty ", pipebench_run( 1, true  ) );
+  pipebench_report( "\nflip dirty ", pipebench_run( 0, true  ) );
+
+  exit( EXIT_SUCCESS );
+}
@@ -0,0 +1,24 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __PIPEBENCH_H
+#define __PIPEBENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "SYS.h"
+
+#include "libc.h"
+
+#define PIPEBENCH_BYTES ( 0x00100000 ) // i.e., 1MB per transfer
+#define PIPEBENCH_CHUNK ( 4 )          // pages per write and per read
+
+#endif
@@ -0,0 +1,101 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "ringbench.h"
+
+/* This measures the time taken per operation for RINGBENCH_OPS tiny ones,
+ * i.e., the 1-byte writes to a pipe a philosopher makes, via
+ *
+ * - a system call each, then one read per RINGBENCH_BATCH to drain them,
+ * - a ring, with RINGBENCH_BATCH writes plus the read submitted via one
+ *   ring_enter, and
+ * - a ring, with RINGBENCH_BATCH no-ops (so the cost of the ring itself),
+ *
+ * using the 24MHz counter, so each time is in units of ~42ns.  Every write
+ * moves one byte, so the difference between the first two is essentially
+ * the cost of a trap through lolevel_handler_svc, amortised over a batch.
+ */
+
+void ringbench_report( char* x, uint32_t t ) {
+  printf( "%-8s %10u total %6u per op\n", x, t, t / RINGBENCH_OPS );
+}
+
+uint32_t ringbench_syscall( int fds[ 2 ] ) {
+  char x[ RINGBENCH_BATCH ];
+
+  uint32_t t0 = SYSCONF->COUNTER_24MHZ;
+
+  for( int done = 0; done < RINGBENCH_OPS; done += RINGBENCH_BATCH ) {
+    for( int i = 0; i < RINGBENCH_BATCH; i++ ) {
+      write( fds[ 1 ], "x", 1 );
+    }
+
+    read( fds[ 0 ], x, RINGBENCH_BATCH );
+  }
+
+  uint32_t t1 = SYSCONF->COUNTER_24MHZ;
+
+  return t1 - t0;
+}
+
+// queue op on r, on fd with buffer x of n bytes, iff. op uses them
+void ringbench_queue( ring_t* r, int op, int fd, const void* x, int n ) {
+  ring_sqe_t* sqe = ring_sqe( r );
+
+  sqe->op        = op;
+  sqe->fd        = fd;
+  sqe->addr      = ( uint32_t )( x );
+  sqe->len       = n;
+  sqe->user_data = 0;
+
+  ring_submit( r );
+}
+
+uint32_t ringbench_ring( ring_t* r, int fds[ 2 ], bool nop ) {
+  char x[ RINGBENCH_BATCH ];
+
+  uint32_t t0 = SYSCONF->COUNTER_24MHZ;
+
+  for( int done = 0; done < RINGBENCH_OPS; done += RINGBENCH_BATCH ) {
+    int n = nop ? RINGBENCH_BATCH : ( RINGBENCH_BATCH + 1 );
+
+    for( int i = 0; i < RINGBENCH_BATCH; i++ ) {
+      ringbench_queue( r, nop ? RING_NOP : RING_WRITE, fds[ 1 ], "x", 1 );
+    }
+    if( !nop ) {
+      ringbench_queue( r, RING_READ, fds[ 0 ], x, RINGBENCH_BATCH );
+    }
+
+    for( int k = ring_enter( 0 ); k < n; k = ring_enter( RING_ENTER_YIELD ) ) {
+      continue;
+    }
+    for( int k = 0; k < n; k++ ) {
+      ring_cqe( r ); ring_cqe_seen( r );
+    }
+  }
+
+  uint32_t t1 = SYSCONF->COUNTER_24MHZ;
+
+  return t1 - t0;
+}
+
+void main_ringbench() {
+  ring_t* r = ring_setup( 0 );
+  int fds[ 2 ];
+
+  if( ( r == NULL ) || ( pipe( fds ) != 0 ) ) {
+    exit( EXIT_FAILURE );
+  }
+
+  printf( "\n" );
+
+  ringbench_report( "syscall", ringbench_syscall( fds ) );
+  ringbench_report( "ring",    ringbench_ring( r, fds, false ) );
+  ringbench_report( "nop",     ringbench_ring( r, fds, true  ) );
+
+  exit( EXIT_SUCCESS );
+}
@@ -0,0 +1,24 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __RINGBENCH_H
+#define __RINGBENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "SYS.h"
+
+#include "libc.h"
+
+#define RINGBENCH_OPS   ( 0x00004000 ) // i.e., 16K operations per measurement
+#define RINGBENCH_BATCH ( 32 )         // operations per ring_enter
+
+#endif